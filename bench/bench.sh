@@ -0,0 +1,62 @@
+#!/bin/bash
+# +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+# SUMMARY: bench.sh
+# Runs pipeline variants of one homework on the standard synthetic
+# workloads and appends one CSV row per (variant, workload) to
+# bench.csv in the current directory. The rows are also printed.
+#
+# USAGE: ../bench/bench.sh hwName variant "command" [variant "command" ..]
+# +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+# NOTE:
+# BENCH_TUPLES and BENCH_USERS set the workload size (default
+# 1000000 tuples from 1000 users). Workloads are generated once
+# into ../bench/data and reused, so reruns compare like with like.
+# A run that takes longer than BENCH_TIMEOUT seconds (default 600)
+# is killed and recorded with status "timeout".
+#
+#   grouped      uniform topics, each user's tuples together
+#   skewed       Zipf 1.2 topics (a few topics get most actions)
+#   interleaved  uniform topics, users completely shuffled
+# +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+
+BENCH_DIR=$(cd "$(dirname "$0")" && pwd)
+TUPLES=${BENCH_TUPLES:-1000000}
+USERS=${BENCH_USERS:-1000}
+TIMEOUT=${BENCH_TIMEOUT:-600}
+CSV=bench.csv
+
+if [ $# -lt 3 ]; then
+  echo "ERROR: Expecting bench.sh hwName variant \"command\" [variant \"command\" ..]"
+  exit 1
+fi
+
+HW=$1
+shift
+
+mkdir -p "$BENCH_DIR/data"
+declare -A WORKLOADS=(
+  [grouped]="-z 0 -i 0"
+  [skewed]="-z 1.2 -i 0"
+  [interleaved]="-z 0 -i 1"
+)
+
+HEADER=""
+if [ ! -f $CSV ]; then
+  HEADER="-H"
+fi
+
+while [ $# -ge 2 ]; do
+  VARIANT=$1
+  COMMAND=$2
+  shift 2
+
+  for W in grouped skewed interleaved; do
+    INPUT="$BENCH_DIR/data/$W-$USERS-$TUPLES.txt"
+    if [ ! -f "$INPUT" ]; then
+      "$BENCH_DIR/gen" -n $TUPLES -u $USERS ${WORKLOADS[$W]} > "$INPUT"
+    fi
+
+    "$BENCH_DIR/pipebench" $HEADER -t $TIMEOUT "$HW/$VARIANT" "$INPUT" "$COMMAND" | tee -a $CSV
+    HEADER=""
+  done
+done
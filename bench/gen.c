@@ -0,0 +1,244 @@
+/*
+ * SUMMARY: gen.c
+ * Synthetic workload generator for the mapper/reducer pipelines. Writes
+ * "(userid,action,topic)" tuples to stdout in the same format as the
+ * input.txt files: comma separated, topics padded with spaces to
+ * LEN_TOPIC, all on one line.
+ *
+ * -n  number of tuples
+ * -u  number of distinct user ids (at most 10000, ids are 4 digits)
+ * -t  number of distinct topics
+ * -z  Zipf exponent of the topic popularity (0 = uniform)
+ * -Z  Zipf exponent of the user activity (0 = every user gets the same
+ *     share). Users stay in id order, user 0 is the most active one;
+ *     1.0 over 1000 users gives the top 1% about 40% of the tuples.
+ * -i  user interleaving, 0..1. 0 keeps every user's tuples together
+ *     (sorted by user like input.txt), 1 shuffles the tuples completely
+ *     and values in between move about that fraction of the tuples.
+ * -s  random seed, the same seed always gives the same file
+ *
+ * USAGE: ./gen [-n tuples] [-u users] [-t topics] [-z skew] [-Z userSkew] [-i interleave] [-s seed]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           DEFINES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+#define DEFAULT_NUM_TUPLES  1000000
+#define DEFAULT_NUM_USERS   1000
+#define DEFAULT_NUM_TOPICS  50
+#define DEFAULT_SEED        5733
+#define MAX_USERS           10000
+#define LEN_TOPIC           15
+#define NUM_ACTIONS         5
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           TYPEDEFS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+typedef struct genTuple
+{
+    uint16_t user;
+    uint16_t topic;
+    char action;
+} gen_tuple_t;
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           GLOBALS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+static const char ACTIONS[NUM_ACTIONS] = {'P', 'L', 'D', 'C', 'S'};
+static uint64_t rngState;
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: rng
+ * xorshift64* generator.. rand() is too short and not the same on
+ * every libc, which would make the files machine dependent.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static uint64_t rng()
+{
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return rngState * 2685821657736338717ull;
+}
+
+// uniform double in [0, 1)
+static double rngUnit()
+{
+    return (rng() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: zipfTable
+ * cumulative distribution of a Zipf(skew) popularity over 'n' ranks.
+ * Rank 0 is the most popular topic.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static double* zipfTable(int n, double skew)
+{
+    double* cdf = (double*)malloc(n * sizeof(double));
+    double sum = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        sum += 1.0 / pow(i + 1, skew);
+        cdf[i] = sum;
+    }
+    for (int i = 0; i < n; i++)
+        cdf[i] /= sum;
+
+    return cdf;
+}
+
+// binary search the cdf for a uniform sample
+static int zipfSample(double* cdf, int n)
+{
+    double u = rngUnit();
+    int lo = 0, hi = n - 1;
+
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (cdf[mid] < u)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                              MAIN
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+int main(int argc, char **argv)
+{
+    long numTuples = DEFAULT_NUM_TUPLES;
+    int numUsers = DEFAULT_NUM_USERS;
+    int numTopics = DEFAULT_NUM_TOPICS;
+    double skew = 0;
+    double userSkew = 0;
+    double interleave = 0;
+    uint64_t seed = DEFAULT_SEED;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:u:t:z:Z:i:s:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n': numTuples = atol(optarg); break;
+            case 'u': numUsers = atoi(optarg); break;
+            case 't': numTopics = atoi(optarg); break;
+            case 'z': skew = atof(optarg); break;
+            case 'Z': userSkew = atof(optarg); break;
+            case 'i': interleave = atof(optarg); break;
+            case 's': seed = strtoull(optarg, NULL, 10); break;
+            default: numTuples = -1; break;
+        }
+    }
+
+    if (numTuples <= 0 || numUsers <= 0 || numUsers > MAX_USERS || numTopics <= 0 ||
+        numTopics > UINT16_MAX || skew < 0 || userSkew < 0 || interleave < 0 || interleave > 1)
+    {
+        fprintf(stderr, "ERROR: Expecting ./gen [-n tuples] [-u users(1..%d)] [-t topics] [-z skew] [-Z userSkew] [-i interleave(0..1)] [-s seed]\n", MAX_USERS);
+        return -1;
+    }
+
+    rngState = seed * 0x9E3779B97F4A7C15ull + 1;
+
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    // every user gets its share of the tuples (the same share unless
+    // -Z is given), in user order
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    gen_tuple_t* tuples = (gen_tuple_t*)malloc(numTuples * sizeof(gen_tuple_t));
+    double* cdf = zipfTable(numTopics, skew);
+    double* userCdf = zipfTable(numUsers, userSkew);
+    if (tuples == NULL || cdf == NULL || userCdf == NULL)
+        return -1;
+
+    int user = 0;
+    for (long i = 0; i < numTuples; i++)
+    {
+        if (userSkew == 0)
+            user = (int)(i * numUsers / numTuples);
+        else
+        {
+            while (user < numUsers - 1 && userCdf[user] < (i + 0.5) / numTuples)
+                user++;
+        }
+        tuples[i].user = (uint16_t)user;
+        tuples[i].topic = (uint16_t)zipfSample(cdf, numTopics);
+        tuples[i].action = ACTIONS[rng() % NUM_ACTIONS];
+    }
+
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    // interleave users.. -i 1 is a full Fisher-Yates shuffle. Below
+    // that, random pairs are swapped until about 'interleave' of the
+    // tuples have left their user's group.
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    if (interleave >= 1)
+    {
+        for (long i = numTuples - 1; i > 0; i--)
+        {
+            long j = (long)(rng() % (uint64_t)(i + 1));
+            gen_tuple_t temp = tuples[i];
+            tuples[i] = tuples[j];
+            tuples[j] = temp;
+        }
+    }
+    else
+    {
+        long swaps = (long)(interleave * numTuples / 2);
+        for (long k = 0; k < swaps; k++)
+        {
+            long i = (long)(rng() % (uint64_t)numTuples);
+            long j = (long)(rng() % (uint64_t)numTuples);
+            gen_tuple_t temp = tuples[i];
+            tuples[i] = tuples[j];
+            tuples[j] = temp;
+        }
+    }
+
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    // write everything out through one large stdio buffer
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    static char outBuf[1 << 16];
+    setvbuf(stdout, outBuf, _IOFBF, sizeof(outBuf));
+
+    for (long i = 0; i < numTuples; i++)
+    {
+        char topic[LEN_TOPIC + 1];
+        snprintf(topic, sizeof(topic), "topic%d", tuples[i].topic);
+        printf("%s(%04d,%c,%-*s)", (i > 0) ? "," : "", tuples[i].user, tuples[i].action, LEN_TOPIC, topic);
+    }
+
+    free(cdf);
+    free(userCdf);
+    free(tuples);
+    return 0;
+}
@@ -0,0 +1,370 @@
+/*
+ * SUMMARY: pipebench.c
+ * Runs one mapper/reducer pipeline variant on an input file and prints
+ * a CSV row with its throughput, result latency and resource usage.
+ *
+ * The command is run with /bin/sh -c, so it can be a pipeline such as
+ * "./mapper | ./reducer". The input file is fed to its stdin through a
+ * pipe and its stdout is read back line by line:
+ *
+ * tuples/s    tuples in the input / wall time until the command exits
+ * p50/p99     latency of the result lines. For a line of user U it is
+ *             the time from when the last tuple of U written before the
+ *             line arrived was accepted by the pipe, to the arrival of
+ *             the line. This is the per-tuple latency that can be seen
+ *             from outside: how long input waits before it shows up in
+ *             a result.
+ * max_rss_kb  peak resident set of the largest process in the command
+ * csw         voluntary + involuntary context switches of all of them
+ *
+ * A "{}" in the command is replaced by the input path (for variants that
+ * read the file themselves). The command's stdin is then left empty and
+ * every tuple counts as written when the command starts.
+ *
+ * The command runs in its own process group. If it has not finished after
+ * the timeout (-t, default BENCH_TIMEOUT seconds) the whole group is
+ * killed and the row's status column says "timeout", so one hung variant
+ * cannot stall a benchmark run.
+ *
+ * USAGE: ./pipebench [-H] [-t seconds] variant input.txt "command"
+ *        -H prints the CSV header first. The input column holds the
+ *        file name without its directory.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           DEFINES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+#define BENCH_CHUNK         4096    // bytes written to the command at a time
+#define BENCH_READ_SIZE     65536
+#define MAX_USERS           10000   // user ids are 4 digits
+#define BENCH_TIMEOUT       600     // seconds before a command is killed
+#define CSV_HEADER          "variant,input,tuples,seconds,tuples_per_sec,p50_latency_us,p99_latency_us,result_lines,max_rss_kb,vol_csw,invol_csw,status"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           TYPEDEFS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+// end offset and user of every tuple in the input
+typedef struct benchTuple
+{
+    long end;       // offset just after the tuple's ')'
+    int user;       // -1 if the user id is not 4 digits
+} bench_tuple_t;
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+static double nowSeconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// 4 digit user id at 'p' -> 0..9999, -1 if it is not one
+static int parseUser(const char* p, const char* end)
+{
+    int user = 0;
+
+    if (end - p < 5 || p[4] != ',')
+        return -1;
+    for (int i = 0; i < 4; i++)
+    {
+        if (p[i] < '0' || p[i] > '9')
+            return -1;
+        user = user * 10 + (p[i] - '0');
+    }
+    return user;
+}
+
+static int compareDoubles(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(double* sorted, long n, double p)
+{
+    if (n == 0)
+        return 0;
+    long i = (long)(p * (n - 1) + 0.5);
+    return sorted[i];
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                              MAIN
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+int main(int argc, char **argv)
+{
+    int header = 0;
+    double timeout = BENCH_TIMEOUT;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "Ht:")) != -1)
+    {
+        if (opt == 'H')
+            header = 1;
+        else if (opt == 't')
+            timeout = atof(optarg);
+    }
+
+    if (argc - optind < 3 || timeout <= 0)
+    {
+        fprintf(stderr, "ERROR: Expecting ./pipebench [-H] [-t seconds] variant input.txt \"command\"\n");
+        return -1;
+    }
+
+    char* variant = argv[optind];
+    char* inputPath = argv[optind + 1];
+    char* command = argv[optind + 2];
+
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    // load the input and index its tuples
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    FILE* f = fopen(inputPath, "rb");
+    struct stat st;
+    if (f == NULL || fstat(fileno(f), &st) == -1)
+    {
+        fprintf(stderr, "ERROR: Could not read %s.\n", inputPath);
+        return -1;
+    }
+
+    long size = st.st_size;
+    char* input = (char*)malloc(size + 1);
+    if (input == NULL || (long)fread(input, 1, size, f) != size)
+        return -1;
+    fclose(f);
+
+    long numTuples = 0, capTuples = 1024;
+    bench_tuple_t* tuples = (bench_tuple_t*)malloc(capTuples * sizeof(bench_tuple_t));
+    for (char* p = input; (p = memchr(p, '(', input + size - p)) != NULL; p++)
+    {
+        char* rb = memchr(p, ')', input + size - p);
+        if (rb == NULL)
+            break;
+        if (numTuples == capTuples)
+        {
+            capTuples *= 2;
+            tuples = (bench_tuple_t*)realloc(tuples, capTuples * sizeof(bench_tuple_t));
+        }
+        tuples[numTuples].end = rb + 1 - input;
+        tuples[numTuples].user = parseUser(p + 1, rb);
+        numTuples++;
+        p = rb;
+    }
+
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    // substitute the input path for "{}"
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    char* slot = strstr(command, "{}");
+    int readsFile = (slot != NULL);
+    if (readsFile)
+    {
+        size_t len = strlen(command) + strlen(inputPath);
+        char* expanded = (char*)malloc(len);
+        snprintf(expanded, len, "%.*s%s%s", (int)(slot - command), command, inputPath, slot + 2);
+        command = expanded;
+    }
+
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    // start the command with a pipe on each side
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    int toChild[2], fromChild[2];
+    if (pipe(toChild) == -1 || pipe(fromChild) == -1)
+        return -1;
+
+    signal(SIGPIPE, SIG_IGN);
+    double start = nowSeconds();
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        setpgid(0, 0);
+        dup2(toChild[0], STDIN_FILENO);
+        dup2(fromChild[1], STDOUT_FILENO);
+        close(toChild[0]);
+        close(toChild[1]);
+        close(fromChild[0]);
+        close(fromChild[1]);
+        execl("/bin/sh", "sh", "-c", command, (char*)NULL);
+        _exit(127);
+    }
+    setpgid(pid, pid);
+    close(toChild[0]);
+    close(fromChild[1]);
+    fcntl(toChild[1], F_SETFL, O_NONBLOCK);
+
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    // feed the input and collect result lines until the command
+    // closes its stdout
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    double* lastWrite = (double*)calloc(MAX_USERS, sizeof(double));
+    long numLatencies = 0, capLatencies = 1024, numLines = 0;
+    double* latencies = (double*)malloc(capLatencies * sizeof(double));
+    char* line = (char*)malloc(BENCH_READ_SIZE);
+    size_t lineLen = 0;
+    char readBuf[BENCH_READ_SIZE];
+    long written = 0, nextTuple = 0;
+    int inFd = toChild[1];
+    int timedOut = 0;
+
+    if (readsFile)
+    {
+        for (; nextTuple < numTuples; nextTuple++)
+        {
+            if (tuples[nextTuple].user >= 0)
+                lastWrite[tuples[nextTuple].user] = start;
+        }
+        close(inFd);
+        inFd = -1;
+    }
+
+    while (1)
+    {
+        struct pollfd fds[2];
+        int nfds = 0;
+        fds[nfds].fd = fromChild[0];
+        fds[nfds++].events = POLLIN;
+        if (inFd >= 0)
+        {
+            fds[nfds].fd = inFd;
+            fds[nfds++].events = POLLOUT;
+        }
+
+        int left = (int)((start + timeout - nowSeconds()) * 1000);
+        int ready = (left > 0) ? poll(fds, nfds, left) : 0;
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (ready == 0)
+        {
+            killpg(pid, SIGKILL);
+            timedOut = 1;
+            break;
+        }
+
+        // input side.. stamp every tuple that is now fully in the pipe
+        if (inFd >= 0 && (fds[1].revents & (POLLOUT | POLLERR | POLLHUP)))
+        {
+            long len = size - written;
+            if (len > BENCH_CHUNK)
+                len = BENCH_CHUNK;
+
+            ssize_t n = write(inFd, input + written, len);
+            if (n > 0)
+            {
+                double t = nowSeconds();
+                written += n;
+                for (; nextTuple < numTuples && tuples[nextTuple].end <= written; nextTuple++)
+                {
+                    if (tuples[nextTuple].user >= 0)
+                        lastWrite[tuples[nextTuple].user] = t;
+                }
+            }
+            if (written == size || (n < 0 && errno != EAGAIN && errno != EINTR))
+            {
+                close(inFd);
+                inFd = -1;
+            }
+        }
+
+        // output side.. one latency sample per result line
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR))
+        {
+            ssize_t n = read(fromChild[0], readBuf, sizeof(readBuf));
+            if (n <= 0)
+                break;
+
+            double t = nowSeconds();
+            for (ssize_t i = 0; i < n; i++)
+            {
+                if (readBuf[i] != '\n')
+                {
+                    if (lineLen < BENCH_READ_SIZE)
+                        line[lineLen++] = readBuf[i];
+                    continue;
+                }
+
+                numLines++;
+                int user = (lineLen > 1 && line[0] == '(') ? parseUser(line + 1, line + lineLen) : -1;
+                if (user >= 0 && lastWrite[user] > 0)
+                {
+                    if (numLatencies == capLatencies)
+                    {
+                        capLatencies *= 2;
+                        latencies = (double*)realloc(latencies, capLatencies * sizeof(double));
+                    }
+                    latencies[numLatencies++] = t - lastWrite[user];
+                }
+                lineLen = 0;
+            }
+        }
+    }
+
+    if (inFd >= 0)
+        close(inFd);
+    close(fromChild[0]);
+
+    // the shell waits for every process of a pipeline, so its rusage
+    // covers all of them
+    int status;
+    struct rusage ru;
+    wait4(pid, &status, 0, &ru);
+    double seconds = nowSeconds() - start;
+
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    // report
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    qsort(latencies, numLatencies, sizeof(double), compareDoubles);
+
+    if (header)
+        printf("%s\n", CSV_HEADER);
+    char statusText[32];
+    if (timedOut)
+        snprintf(statusText, sizeof(statusText), "timeout");
+    else if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+        snprintf(statusText, sizeof(statusText), "ok");
+    else
+        snprintf(statusText, sizeof(statusText), "exit%d", WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+
+    printf("%s,%s,%ld,%.4f,%.0f,%.1f,%.1f,%ld,%ld,%ld,%ld,%s\n",
+           variant, (strrchr(inputPath, '/') != NULL) ? strrchr(inputPath, '/') + 1 : inputPath, numTuples, seconds, numTuples / seconds,
+           percentile(latencies, numLatencies, 0.50) * 1e6,
+           percentile(latencies, numLatencies, 0.99) * 1e6,
+           numLines, ru.ru_maxrss, ru.ru_nvcsw, ru.ru_nivcsw, statusText);
+
+    free(line);
+    free(latencies);
+    free(lastWrite);
+    free(tuples);
+    free(input);
+    return 0;
+}
@@ -1,62 +1,142 @@
-#include "common.h"
-
-/*
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
- *                            GLOBALS
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
- */
-
-// The RULE_ACTIONS and RULE_WEIGHTS below define how each action is mapped
-// to the appropriate weight.
-const char RULE_ACTION[MAPPING_COUNT]    = {'P',     'L',    'D',    'C',    'S'};
-const int32_t RULE_WEIGHT[MAPPING_COUNT] = {50,      20,     -10,    30,     40};
-
-/*
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
- *                           FUNCTIONS
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
- */
-
-/*
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
- * SUMMARY: console_string_read
- * This function reads in characters from the terminal until
- * it overflows the MAX_INPUT_STRING_LENGTH (returning an error)
- * or it reaches an CR character from the space bar.
- * 
- * RETURN: length of the string before reaching CR. Otherwise, -1.
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
- */
-int32_t console_string_read(char* store_string_location)
-{
-    char nextCharacter = 'X';
-    uint32_t stringLength = 0;
-
-    for (uint32_t i = 0; i < MAX_INPUT_STRING_LENGTH; i++)
-    {
-        nextCharacter = getchar();
-        store_string_location[i] = nextCharacter;
-        stringLength++;
-
-        if (nextCharacter == (char)ENTER) 
-            return stringLength;
-    }
-
-    return -1;
-}
-
-/*
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
- * SUMMARY: console_string_write
- * This function writes characters to the terminal until reaching
- * the string length paramter.
- * 
- * NOTE: This function doesn't require placing a NULL character
- * at the end of the string to work.
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
- */
-void console_string_write(char* string, uint32_t len)
-{
-    for (uint32_t i = 0; i < len; i++)
-        putchar(string[i]);
-}
\ No newline at end of file
+#include "common.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                            GLOBALS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+// The RULE_ACTIONS and RULE_WEIGHTS below define how each action is mapped
+// to the appropriate weight.
+#define _RULE_ACTION(action, weight) action,
+#define _RULE_WEIGHT(action, weight) weight,
+
+const char RULE_ACTION[MAPPING_COUNT]    = {DEFAULT_RULES(_RULE_ACTION)};
+const int32_t RULE_WEIGHT[MAPPING_COUNT] = {DEFAULT_RULES(_RULE_WEIGHT)};
+
+// the same rules indexed by action byte, so mapping is a single load.
+// Filled by rulesDefault (or rulesLoad) before any tuple is mapped.
+int32_t RULE_TABLE[RULE_TABLE_SIZE];
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: console_string_read
+ * This function reads in characters from the terminal until
+ * it overflows the MAX_INPUT_STRING_LENGTH (returning an error)
+ * or it reaches an CR character from the space bar.
+ * 
+ * RETURN: length of the string before reaching CR. Otherwise, -1.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int32_t console_string_read(char* store_string_location)
+{
+    char nextCharacter = 'X';
+    uint32_t stringLength = 0;
+
+    for (uint32_t i = 0; i < MAX_INPUT_STRING_LENGTH; i++)
+    {
+        nextCharacter = getchar();
+        store_string_location[i] = nextCharacter;
+        stringLength++;
+
+        if (nextCharacter == (char)ENTER) 
+            return stringLength;
+    }
+
+    return -1;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: console_string_write
+ * This function writes characters to the terminal until reaching
+ * the string length paramter.
+ * 
+ * NOTE: This function doesn't require placing a NULL character
+ * at the end of the string to work.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void console_string_write(char* string, uint32_t len)
+{
+    for (uint32_t i = 0; i < len; i++)
+        putchar(string[i]);
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: rulesDefault
+ * This function fills RULE_TABLE with the default rule set.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void rulesDefault(void)
+{
+    for (int i = 0; i < RULE_TABLE_SIZE; i++)
+        RULE_TABLE[i] = RULE_NONE;
+
+    for (int i = 0; i < MAPPING_COUNT; i++)
+        RULE_TABLE[(uint8_t)RULE_ACTION[i]] = RULE_WEIGHT[i];
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: rulesLoad
+ * This function replaces the rule set with the one in a config
+ * file. Each line holds an action character and its weight, e.g.
+ * "P 50". Blank lines and lines starting with '#' are skipped.
+ * 
+ * RETURN: number of rules loaded. Otherwise, -1 and the current
+ * rules are left as they were.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int rulesLoad(const char* path)
+{
+    int32_t table[RULE_TABLE_SIZE];
+    char line[RULE_LINE_LENGTH];
+    int lineNum = 0;
+    int count = 0;
+
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "ERROR: Could not open the rules file %s.\n", path);
+        return -1;
+    }
+
+    for (int i = 0; i < RULE_TABLE_SIZE; i++)
+        table[i] = RULE_NONE;
+
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        char action, extra;
+        int32_t weight;
+        int fields;
+
+        lineNum++;
+        fields = sscanf(line, " %c %d %c", &action, &weight, &extra);
+
+        // blank line or comment
+        if (fields < 1 || action == '#')
+            continue;
+
+        // exactly one action and one weight per line, each action once
+        if (fields != 2 || weight == RULE_NONE || table[(uint8_t)action] != RULE_NONE)
+        {
+            fprintf(stderr, "ERROR: %s:%d: expecting a new action and a weight.\n", path, lineNum);
+            fclose(file);
+            return -1;
+        }
+
+        table[(uint8_t)action] = weight;
+        count++;
+    }
+
+    fclose(file);
+    memcpy(RULE_TABLE, table, sizeof(RULE_TABLE));
+    return count;
+}
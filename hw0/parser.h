@@ -0,0 +1,62 @@
+#ifndef _PARSER_SRC_HEADER_
+#define _PARSER_SRC_HEADER_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "common.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                            DEFINES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+#define PARSER_BUF_SIZE     (1 << 20)   // bytes read from the input per read(2)
+#define PARSER_BATCH_SIZE   256         // tuples a caller typically asks for at once
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           TYPEDEFS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+typedef struct tupleIn 
+{
+    int8_t error;       // ERROR -  0 = tuple data is valid, 1 = There was an error while reading the tuple.
+    char userid[4];     // USERID - 4 digit number
+    char action;        // ACTION - Character to map using the rules defined in the 'main' summary.
+    char topic[15];     // TOPIC - Pad this with space if unused.
+
+} tupleIn_t;
+
+// parser structure reads the input in large blocks and cuts complete
+// (userid,action,topic) tuples out of the block with memchr.
+typedef struct parserStruct
+{
+    // public parameters
+    int fd;                 // input file descriptor (STDIN_FILENO for the console)
+    uint64_t errors;        // malformed tuples that were skipped
+
+    // functions
+    int (*read)(struct parserStruct* p, tupleIn_t* tuples, int max); // fills up to max tuples
+
+    // private parameters
+    char* _buf;
+    size_t _start;          // first byte not parsed yet
+    size_t _end;            // end of the valid bytes in _buf
+    int _eof;
+} parser_t;
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+int parser(parser_t* p, int fd);
+void parserDestruct(parser_t* p);
+int parserRead(parser_t* p, tupleIn_t* tuples, int max);
+
+#endif
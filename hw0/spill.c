@@ -0,0 +1,365 @@
+/*
+ * SUMMARY: spill
+ * This file reduces tuples that are not grouped by user id with a
+ * bounded amount of memory.
+ *
+ * NOTE: The regular reducer prints a user as soon as the user id
+ * changes, which only gives one result per user when the input is
+ * sorted. Here every user keeps its own dictionary until EOF. The
+ * bytes held by the dictionaries are tracked, and once they exceed
+ * the budget every user is written to a temp file as one run, sorted
+ * by user id, and the memory is released. At EOF the runs are merged
+ * (k-way, by user id) and each user's topics are added up run by run.
+ * Runs are in input order, so topics still come out in the order they
+ * were first seen. Users are written in user id order.
+ */
+
+#include <unistd.h>
+#include "spill.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           TYPEDEFS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+// read position in one run while the runs are merged
+typedef struct spillCursor
+{
+    long pos;               // next file offset to read
+    long end;               // end of the run
+    int next;               // next record in buf
+    int count;              // records in buf
+    spill_record_t buf[SPILL_READ_BATCH];
+} spill_cursor_t;
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+static size_t _spillDictBytes(dict_t* d);
+static int _spillCompareUsers(const void* a, const void* b);
+static void _spillReset(spill_t* s);
+static int _spillRun(spill_t* s);
+static spill_record_t* _spillHead(spill_t* s, spill_cursor_t* cur);
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: spill
+ * initialize an empty table that spills once it holds more than
+ * 'budget' bytes.
+ *
+ * RETURN: 0 on success, -1 if memory cannot be allocated.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int spill(spill_t* s, size_t budget)
+{
+    s->budget = budget;
+    s->peak = 0;
+    s->runs = 0;
+    s->records = 0;
+    s->_numUsers = 0;
+    s->_capUsers = SPILL_INIT_USERS;
+    s->_file = NULL;
+    s->_runEnd = NULL;
+    s->_users = (spill_user_t*)malloc(s->_capUsers*sizeof(spill_user_t));
+    s->_index = dict();
+    if (s->_users == NULL || s->_index == NULL)
+        return -1;
+    s->_bytes = _spillDictBytes(s->_index) + s->_capUsers*sizeof(spill_user_t);
+
+    // connect functions
+    s->add = &spillAdd;
+    s->write = &spillWrite;
+    return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: spillDestruct
+ * deallocate the table and close (delete) the temp file.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void spillDestruct(spill_t* s)
+{
+    for (uint32_t u = 0; u < s->_numUsers; u++)
+        dictFreeNodes(s->_users[u].dictionary);
+    dictFreeNodes(s->_index);
+    free(s->_users);
+    free(s->_runEnd);
+    if (s->_file != NULL)
+        fclose(s->_file);
+
+    s->_index = NULL;
+    s->_users = NULL;
+    s->_runEnd = NULL;
+    s->_file = NULL;
+    s->_numUsers = 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: spillAdd -> connects to spill.add
+ * add 'weight' to the user's topic. Spills every user to the temp
+ * file if the table grew past the budget.
+ *
+ * RETURN: 0 on success, -1 if memory or the temp file fail.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int spillAdd(spill_t* s, char* userid, char* topic, int32_t weight)
+{
+    char key[LEN_TOPIC];
+    size_t before = _spillDictBytes(s->_index);
+
+    // find the user's slot, or append a new one
+    memset(key, SPACE, LEN_TOPIC);
+    memcpy(key, userid, LEN_USER_ID);
+    uint32_t count = s->_index->count;
+    entry_t* entry = dictAddToValue(s->_index, key, 0);
+    if (entry == NULL)
+        return -1;
+
+    if (s->_index->count != count)
+    {
+        if (s->_numUsers == s->_capUsers)
+        {
+            spill_user_t* users = (spill_user_t*)realloc(s->_users, 2*s->_capUsers*sizeof(spill_user_t));
+            if (users == NULL)
+                return -1;
+            s->_bytes += s->_capUsers*sizeof(spill_user_t);
+            s->_users = users;
+            s->_capUsers *= 2;
+        }
+
+        spill_user_t* user = &s->_users[s->_numUsers];
+        memcpy(user->userid, userid, LEN_USER_ID);
+        if ((user->dictionary = dict()) == NULL)
+            return -1;
+        entry->value = s->_numUsers++;
+        s->_bytes += _spillDictBytes(user->dictionary);
+    }
+    s->_bytes += _spillDictBytes(s->_index) - before;
+
+    // reduce into the user's own dictionary
+    dict_t* dictionary = s->_users[entry->value].dictionary;
+    before = _spillDictBytes(dictionary);
+    if (dictAddToValue(dictionary, topic, weight) == NULL)
+        return -1;
+    s->_bytes += _spillDictBytes(dictionary) - before;
+
+    if (s->_bytes > s->peak)
+        s->peak = s->_bytes;
+
+    if (s->_bytes > s->budget)
+        return _spillRun(s);
+    return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: spillWrite -> connects to spill.write
+ * write every user once to 'out', in user id order. If nothing was
+ * spilled the table is written straight from memory. Otherwise the
+ * table becomes the last run and all runs are merged. Call once,
+ * after the last tuple.
+ *
+ * RETURN: 0 on success, -1 if memory or the temp file fail.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int spillWrite(spill_t* s, output_t* out)
+{
+    if (s->runs == 0)
+    {
+        qsort(s->_users, s->_numUsers, sizeof(spill_user_t), &_spillCompareUsers);
+        for (uint32_t u = 0; u < s->_numUsers; u++)
+            outputDict(out, s->_users[u].userid, s->_users[u].dictionary);
+        _spillReset(s);
+        return 0;
+    }
+
+    if ((s->_numUsers > 0 && _spillRun(s) == -1) || fflush(s->_file) == EOF)
+        return -1;
+
+    int numRuns = (int)s->runs;
+    spill_cursor_t* cur = (spill_cursor_t*)malloc(numRuns*sizeof(spill_cursor_t));
+    if (cur == NULL)
+        return -1;
+
+    for (int r = 0; r < numRuns; r++)
+    {
+        cur[r].pos = (r == 0) ? 0 : s->_runEnd[r - 1];
+        cur[r].end = s->_runEnd[r];
+        cur[r].next = 0;
+        cur[r].count = 0;
+    }
+
+    while (1)
+    {
+        // smallest user id at the head of a run
+        spill_record_t* min = NULL;
+        for (int r = 0; r < numRuns; r++)
+        {
+            spill_record_t* head = _spillHead(s, &cur[r]);
+            if (head != NULL && (min == NULL || userKeyOrder(head->userid) < userKeyOrder(min->userid)))
+                min = head;
+        }
+        if (min == NULL)
+            break;
+
+        // add the user up run by run.. earlier runs hold earlier topics
+        char userid[LEN_USER_ID];
+        memcpy(userid, min->userid, LEN_USER_ID);
+        dict_t* total = dict();
+        if (total == NULL)
+        {
+            free(cur);
+            return -1;
+        }
+
+        for (int r = 0; r < numRuns; r++)
+        {
+            spill_record_t* head;
+            while ((head = _spillHead(s, &cur[r])) != NULL && userKey(head->userid) == userKey(userid))
+            {
+                dictAddToValue(total, head->topic, head->weight);
+                cur[r].next++;
+            }
+        }
+
+        outputDict(out, userid, total);
+        dictFreeNodes(total);
+    }
+
+    free(cur);
+    return 0;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                        PRIVATE FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _spillDictBytes
+ * heap bytes held by a dictionary: the struct, the slot array and
+ * the index (both indexes while a resize is in progress).
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static size_t _spillDictBytes(dict_t* d)
+{
+    size_t bytes = sizeof(dict_t) + d->capacity*sizeof(entry_t) + (d->mask + 1)*sizeof(int32_t);
+
+    if (d->oldIndex != NULL)
+        bytes += (d->oldMask + 1)*sizeof(int32_t);
+    return bytes;
+}
+
+// qsort comparison of two users by id
+static int _spillCompareUsers(const void* a, const void* b)
+{
+    uint32_t ka = userKeyOrder(((spill_user_t*)a)->userid);
+    uint32_t kb = userKeyOrder(((spill_user_t*)b)->userid);
+    return (ka > kb) - (ka < kb);
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _spillReset
+ * free every user's dictionary and start an empty table. The user
+ * array keeps its size.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static void _spillReset(spill_t* s)
+{
+    for (uint32_t u = 0; u < s->_numUsers; u++)
+        dictFreeNodes(s->_users[u].dictionary);
+    s->_numUsers = 0;
+
+    dictFreeNodes(s->_index);
+    s->_index = dict();
+    s->_bytes = _spillDictBytes(s->_index) + s->_capUsers*sizeof(spill_user_t);
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _spillRun
+ * append every user in the table to the temp file, sorted by user
+ * id, as one run. The table is emptied.
+ *
+ * RETURN: 0 on success, -1 if the temp file fails.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static int _spillRun(spill_t* s)
+{
+    spill_record_t rec;
+
+    if (s->_file == NULL && (s->_file = tmpfile()) == NULL)
+        return -1;
+
+    long* runEnd = (long*)realloc(s->_runEnd, (s->runs + 1)*sizeof(long));
+    if (runEnd == NULL)
+        return -1;
+    s->_runEnd = runEnd;
+
+    qsort(s->_users, s->_numUsers, sizeof(spill_user_t), &_spillCompareUsers);
+    for (uint32_t u = 0; u < s->_numUsers; u++)
+    {
+        dict_t* dictionary = s->_users[u].dictionary;
+
+        memcpy(rec.userid, s->_users[u].userid, LEN_USER_ID);
+        for (uint32_t e = 0; e < dictionary->count; e++)
+        {
+            memcpy(rec.topic, dictionary->entries[e].key.text, LEN_TOPIC);
+            rec.weight = dictionary->entries[e].value;
+            if (fwrite(&rec, sizeof(rec), 1, s->_file) != 1)
+                return -1;
+        }
+        s->records += dictionary->count;
+    }
+
+    s->_runEnd[s->runs++] = ftell(s->_file);
+    _spillReset(s);
+    return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _spillHead
+ * the next unread record of a run, reading SPILL_READ_BATCH more
+ * records from the temp file when the buffer is used up.
+ *
+ * RETURN: the record, NULL once the run is exhausted.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static spill_record_t* _spillHead(spill_t* s, spill_cursor_t* cur)
+{
+    if (cur->next == cur->count)
+    {
+        long left = cur->end - cur->pos;
+        size_t want = sizeof(cur->buf);
+        if ((size_t)left < want)
+            want = left;
+        if (want == 0)
+            return NULL;
+
+        ssize_t len = pread(fileno(s->_file), cur->buf, want, cur->pos);
+        if (len < (ssize_t)sizeof(spill_record_t))
+            return NULL;
+
+        cur->count = len / sizeof(spill_record_t);
+        cur->next = 0;
+        cur->pos += cur->count*sizeof(spill_record_t);
+    }
+
+    return &cur->buf[cur->next];
+}
@@ -1,170 +1,402 @@
-#include <stdint.h>
-#include <stdio.h>
-#include <string.h>
-#include <unistd.h>
-#include <sys/wait.h>
-#include <stdlib.h>
-#include "common.h"
-
-/*
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
- *                      DEFINES
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
- */
-
-#define COMBINER_DEBUG_MODE 0
-#define PIPE_SIZE           100
-#define STDIN_FD            0
-#define STDOUT_FD           1
-#define NUM_CHILDREN        2
-
-/*
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
- *                      PROTOTYPES
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
- */
-
-void mapper(int* pipeFd);
-void reducer(int* pipeFd);
-void errExit(char* string);
-
-/*
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
- *                    MAIN / PROCESSES
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
- */
-
-int main(void)
-{
-  int pipeFd[2];                      // pipe file descriptors (0 == read, 1 == write)
-  void (*task[NUM_CHILDREN])(int*);   // tasks to be completed by children
-
-  setbuf(stdout, NULL); // do not buffer stdout
-  setbuf(stdin, NULL); // do not buffer stdin
-
-  // assign the list of tasks to the children
-  task[0] = &mapper;
-  task[1] = &reducer;
-
-  // set up pipe so reader/writer handles will be copied to
-  // all children.
-  if (pipe(pipeFd) == -1)
-    printf("ERROR: Pipe instantiation..");
-
-  // instantiate multiple children and pass their tasks
-  for (uint16_t i = 0; i < NUM_CHILDREN; i++)
-  {
-    pid_t pid = fork();
-
-    // fork error
-    if (pid == -1)
-    {
-	    printf("ERROR: Fork can't produce child.."); 
-      wait(NULL);
-      exit(0);
-    }
-
-    // child (tasks - mapper or reducer)
-    else if (pid == 0)
-    {
-      (*task[i])(pipeFd);
-    }
-
-    // parent (combiner - child manager)
-    else
-    {
-      continue;
-    }
-  }
-
-  // close both ends of the pipe since the combiner doesn't
-  // need write or read access
-  if (close(pipeFd[0]) == -1)
-    errExit("ERROR: Closing read end of pipe in parent");
-
-  if (close(pipeFd[1]) == -1)
-    errExit("ERROR: Closing write end of pipe in parent");
-
-  // wait for all children to close and then exit
-  for (uint16_t i = 0; i < NUM_CHILDREN; i++)
-    wait(NULL);
-
-  exit(0);
-  return 0;
-}
-
-/*
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
- * SUMMARY: mapper
- * This process runs the mapper program and routes the 
- * standard output to pipe.
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
- */
-void mapper(int* pipeFd)
-{
-  debugger("Starting MAPPER..", COMBINER_DEBUG_MODE);
-
-  // this process is the writer, so the read end of the 
-  // pipe is closed.
-  if (close(pipeFd[0]) == -1)
-    errExit("ERROR: Closing read end of pipe in mapper");
-
-  // route the standard output of this process to the input of the pipe
-  dup2(pipeFd[1], STDOUT_FD);
-  int err = execlp("./mapper", "./mapper", NULL);
-
-  // Error if the process gets to this point..
-  if (err == -1)
-  {
-    printf("ERROR: MAPPER is exitting..");
-    close(pipeFd[1]);
-    exit(0); // flush buffer, close process
-  }
-}
-
-/*
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
- * SUMMARY: reducer
- * This process runs the reducer program and routes the 
- * standard input to pipe.
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
- */
-void reducer(int* pipeFd)
-{
-  debugger("Starting REDUCER..", COMBINER_DEBUG_MODE);
-
-  // this process is the reader, so the write end of the pipe
-  // is closed.
-  if (close(pipeFd[1]) == -1)
-    errExit("ERROR: Closing write end of pipe in reducer");
-
-  // route the standard input of this process to be the output of the pipe
-  dup2(pipeFd[0], STDIN_FD);
-  int err = execlp("./reducer", "./reducer", NULL);
-
-  // Error if the process gets to this point..
-  if (err == -1)
-  {
-    printf("ERROR: REDUCER is exitting..\n");
-    close(pipeFd[0]);
-    exit(0);
-  }
-}
-
-/*
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
- *                       FUNCTIONS
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
- */
-
-/*
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
- * SUMMARY: errExit
- * This function prints out the message and exits successfully.
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
- */
-void errExit(char* string)
-{
-  printf("%s\n", string);
-  exit(0);
-}
\ No newline at end of file
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <stdlib.h>
+#include "common.h"
+#include "frame.h"
+#include "ring.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      DEFINES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+#define COMBINER_DEBUG_MODE 0
+#define PIPE_SIZE           100
+#define STDIN_FD            0
+#define STDOUT_FD           1
+#define MAX_REDUCERS        64
+#define MERGE_LINE_SIZE     64    // longer than any "(userid,topic,weight)\n" line
+#define COPY_BUF_SIZE       (64*1024)
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+void mapper(void);
+void reducer(int reducerNum);
+void closePipes(void);
+void concatOutputs(void);
+void mergeOutputs(void);
+void errExit(char* string);
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                       GLOBALS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+// protocol flag handed to both children. NULL ends the argument list
+// early, so text mode execs the programs without any flag.
+char* protocolFlag = NULL;
+char* rulesFile = NULL; // -w.. handed to the mapper
+
+int numReducers = 1;
+int (*pipeFd)[2];     // one pipe per reducer (0 == read, 1 == write)
+ring_shared_t** rings; // -s.. the combiner's mapping of each reducer's ring
+FILE** outFiles;      // one result file per reducer, NULL when writing to stdout
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                    MAIN / PROCESSES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+int main(int argc, char** argv)
+{
+  int mergeOrdered = 0;
+  int opt;
+
+  // -b switches the mapper -> reducer pipes to packed binary records
+  // -s replaces the pipes with shared memory rings of binary records
+  // -r runs N reducers, each owning a hash partition of the user ids
+  // -o merges the reducers' results in user id order
+  while ((opt = getopt(argc, argv, "bsr:ow:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'b': protocolFlag = FRAME_FLAG; break;
+      case 's': protocolFlag = RING_FLAG; break;
+      case 'r': numReducers = atoi(optarg); break;
+      case 'o': mergeOrdered = 1; break;
+      case 'w': rulesFile = optarg; break;
+      default: numReducers = -1; break;
+    }
+  }
+
+  if (numReducers < 1 || numReducers > MAX_REDUCERS)
+    errExit("ERROR: Expecting ./combiner [-b | -s] [-r reducers(1..64)] [-o] [-w rules]");
+
+  setbuf(stdout, NULL); // do not buffer stdout
+  setbuf(stdin, NULL); // do not buffer stdin
+
+  pipeFd = malloc(numReducers * sizeof(*pipeFd));
+  outFiles = calloc(numReducers, sizeof(FILE*));
+  rings = calloc(numReducers, sizeof(ring_shared_t*));
+  if (pipeFd == NULL || outFiles == NULL || rings == NULL)
+    errExit("ERROR: Allocating pipes");
+
+  // set up one pipe per reducer so reader/writer handles will be
+  // copied to all children. With more than one reducer, the results
+  // are collected in temporary files and written out by the combiner
+  // so the reducers' output blocks can't interleave on stdout.
+  for (int i = 0; i < numReducers; i++)
+  {
+    // a ring is one memfd.. a second fd stands in for the write end so
+    // the children route and close it exactly like a pipe.
+    if (protocolFlag != NULL && strcmp(protocolFlag, RING_FLAG) == 0)
+    {
+      if ((pipeFd[i][0] = ringCreate()) == -1 || (pipeFd[i][1] = dup(pipeFd[i][0])) == -1)
+        errExit("ERROR: Ring instantiation..");
+
+      if ((rings[i] = ringMap(pipeFd[i][0])) == NULL)
+        errExit("ERROR: Mapping ring..");
+    }
+    else if (pipe(pipeFd[i]) == -1)
+      errExit("ERROR: Pipe instantiation..");
+
+    if (numReducers > 1 && (outFiles[i] = tmpfile()) == NULL)
+      errExit("ERROR: Creating reducer output file");
+  }
+
+  // instantiate the mapper and all the reducers
+  pid_t mapperPid = -1;
+  for (int i = -1; i < numReducers; i++)
+  {
+    pid_t pid = fork();
+    if (i == -1)
+      mapperPid = pid;
+
+    // fork error
+    if (pid == -1)
+    {
+      printf("ERROR: Fork can't produce child..");
+      wait(NULL);
+      exit(0);
+    }
+
+    // child (tasks - mapper or reducer)
+    else if (pid == 0)
+    {
+      if (i == -1)
+        mapper();
+      else
+        reducer(i);
+    }
+  }
+
+  // close every pipe since the combiner doesn't need write or
+  // read access
+  closePipes();
+
+  // wait for all children to close. Once the mapper is gone its rings
+  // are closed here as well, so the reducers finish even if it crashed.
+  for (int i = 0; i <= numReducers; i++)
+  {
+    if (wait(NULL) != mapperPid)
+      continue;
+
+    for (int r = 0; r < numReducers; r++)
+    {
+      if (rings[r] != NULL)
+        ringClose(rings[r]);
+    }
+  }
+
+  for (int i = 0; i < numReducers; i++)
+    ringUnmap(rings[i]);
+
+  // hand the reducers' results to stdout
+  if (numReducers > 1)
+  {
+    if (mergeOrdered)
+      mergeOutputs();
+    else
+      concatOutputs();
+
+    for (int i = 0; i < numReducers; i++)
+      fclose(outFiles[i]);
+  }
+
+  free(rings);
+  free(outFiles);
+  free(pipeFd);
+  exit(0);
+  return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: mapper
+ * This process runs the mapper program and routes its
+ * output to the pipes. With one reducer the standard output
+ * is the pipe. With N reducers, partition i is written to
+ * file descriptor MAPPER_PARTITION_FD + i.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void mapper(void)
+{
+  char reducers[8];
+  char* args[7];
+  int numArgs = 0;
+
+  debugger("Starting MAPPER..", COMBINER_DEBUG_MODE);
+
+  if (numReducers == 1)
+  {
+    // this process is the writer, so the read end of the
+    // pipe is closed.
+    if (close(pipeFd[0][0]) == -1)
+      errExit("ERROR: Closing read end of pipe in mapper");
+
+    // route the standard output of this process to the input of the pipe
+    dup2(pipeFd[0][1], STDOUT_FD);
+  }
+  else
+  {
+    // the partition fds overlap the fds the pipes were given, so move
+    // the write ends out of the way first and then into place.
+    int high[MAX_REDUCERS];
+    for (int i = 0; i < numReducers; i++)
+      high[i] = fcntl(pipeFd[i][1], F_DUPFD, MAPPER_PARTITION_FD + numReducers);
+
+    closePipes();
+    for (int i = 0; i < numReducers; i++)
+      fclose(outFiles[i]);
+
+    for (int i = 0; i < numReducers; i++)
+    {
+      if (high[i] == -1 || dup2(high[i], MAPPER_PARTITION_FD + i) == -1)
+        errExit("ERROR: Routing partition to pipe in mapper");
+      close(high[i]);
+    }
+  }
+
+  // ./mapper [-b] [-r N] [-w rules]
+  snprintf(reducers, sizeof(reducers), "%d", numReducers);
+  args[numArgs++] = "./mapper";
+  if (protocolFlag != NULL)
+    args[numArgs++] = protocolFlag;
+  if (numReducers > 1)
+  {
+    args[numArgs++] = "-r";
+    args[numArgs++] = reducers;
+  }
+  if (rulesFile != NULL)
+  {
+    args[numArgs++] = "-w";
+    args[numArgs++] = rulesFile;
+  }
+  args[numArgs] = NULL;
+
+  int err = execvp(args[0], args);
+
+  // Error if the process gets to this point..
+  if (err == -1)
+  {
+    printf("ERROR: MAPPER is exitting..");
+    exit(0); // flush buffer, close process
+  }
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: reducer
+ * This process runs the reducer program and routes the
+ * standard input to its partition's pipe. With N reducers
+ * the standard output goes to the reducer's result file.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void reducer(int reducerNum)
+{
+  debugger("Starting REDUCER..", COMBINER_DEBUG_MODE);
+
+  // route the standard input of this process to be the output of the
+  // pipe, then close every other handle.. this reducer only reads.
+  dup2(pipeFd[reducerNum][0], STDIN_FD);
+  if (outFiles[reducerNum] != NULL)
+    dup2(fileno(outFiles[reducerNum]), STDOUT_FD);
+
+  closePipes();
+  for (int i = 0; i < numReducers; i++)
+  {
+    if (outFiles[i] != NULL)
+      fclose(outFiles[i]);
+  }
+
+  int err = execlp("./reducer", "./reducer", protocolFlag, NULL);
+
+  // Error if the process gets to this point..
+  if (err == -1)
+  {
+    printf("ERROR: REDUCER is exitting..\n");
+    exit(0);
+  }
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                       FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: closePipes
+ * Close both ends of every reducer pipe. A reader only sees
+ * the end of its input once every copy of the write end is
+ * closed.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void closePipes(void)
+{
+  for (int i = 0; i < numReducers; i++)
+  {
+    if (close(pipeFd[i][0]) == -1)
+      errExit("ERROR: Closing read end of pipe");
+
+    if (close(pipeFd[i][1]) == -1)
+      errExit("ERROR: Closing write end of pipe");
+  }
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: concatOutputs
+ * Copy the reducers' result files to stdout in reducer order.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void concatOutputs(void)
+{
+  char buf[COPY_BUF_SIZE];
+  size_t len;
+
+  for (int i = 0; i < numReducers; i++)
+  {
+    rewind(outFiles[i]);
+    while ((len = fread(buf, 1, sizeof(buf), outFiles[i])) > 0)
+      fwrite(buf, 1, len, stdout);
+  }
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: mergeOutputs
+ * Merge the reducers' result files to stdout in user id order.
+ * Every user id belongs to exactly one reducer, so the lines of
+ * a user are moved as one group. When the input is sorted by
+ * user id (like input.txt) the result matches a single reducer.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void mergeOutputs(void)
+{
+  char (*line)[MERGE_LINE_SIZE] = malloc(numReducers * MERGE_LINE_SIZE);
+  int* valid = malloc(numReducers * sizeof(int));
+  static char outBuf[COPY_BUF_SIZE];
+
+  if (line == NULL || valid == NULL)
+    errExit("ERROR: Allocating merge buffers");
+
+  setvbuf(stdout, outBuf, _IOFBF, sizeof(outBuf));
+
+  // the user id starts right after the left bracket
+  for (int i = 0; i < numReducers; i++)
+  {
+    rewind(outFiles[i]);
+    valid[i] = (fgets(line[i], MERGE_LINE_SIZE, outFiles[i]) != NULL);
+  }
+
+  while (1)
+  {
+    // smallest user id at the head of a file.. ties keep reducer order
+    int min = -1;
+    for (int i = 0; i < numReducers; i++)
+    {
+      if (valid[i] && (min == -1 || memcmp(line[i] + 1, line[min] + 1, LEN_USER_ID) < 0))
+        min = i;
+    }
+    if (min == -1)
+      break;
+
+    // write out every line of that user
+    char userid[LEN_USER_ID];
+    memcpy(userid, line[min] + 1, LEN_USER_ID);
+    do
+    {
+      fputs(line[min], stdout);
+      valid[min] = (fgets(line[min], MERGE_LINE_SIZE, outFiles[min]) != NULL);
+    } while (valid[min] && memcmp(line[min] + 1, userid, LEN_USER_ID) == 0);
+  }
+
+  fflush(stdout);
+  free(valid);
+  free(line);
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: errExit
+ * This function prints out the message and exits successfully.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void errExit(char* string)
+{
+  printf("%s\n", string);
+  exit(0);
+}
@@ -1,48 +1,124 @@
-#ifndef _SRC_COMMON_HEADER_
-#define _SRC_COMMON_HEADER_
-
-#include <stdint.h>
-#include <stdio.h>
-#include <string.h>
-
-/*
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
- *                            DEFINES
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
- */
-
-#define ENTER                   10
-#define LB                      '('
-#define RB                      ')'
-#define DELIMITER               ','
-#define SPACE                   32
-
-#define MAX_INPUT_STRING_LENGTH 50
-#define LEN_USER_ID             4
-#define LEN_ACTION              1
-#define LEN_TOPIC               15
-#define LEN_WEIGHT              3
-#define MAPPING_COUNT           5
-
-/*
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
- *                            EXTERNS
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
- */
-
-// The RULE_ACTIONS and RULE_WEIGHTS below define how each action is mapped
-// to the appropriate weight.
-extern const char RULE_ACTION[MAPPING_COUNT];
-extern const int32_t RULE_WEIGHT[MAPPING_COUNT];
-
-/*
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
- *                           PROTOTYPES
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
- */
-
-int32_t console_string_read(char* store_string_location);
-void console_string_write(char* string, uint32_t len);
-uint16_t debugger(char* string, uint16_t debugMode);
-
+#ifndef _SRC_COMMON_HEADER_
+#define _SRC_COMMON_HEADER_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                            DEFINES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+#define ENTER                   10
+#define LB                      '('
+#define RB                      ')'
+#define DELIMITER               ','
+#define SPACE                   32
+
+#define MAX_INPUT_STRING_LENGTH 50
+#define LEN_USER_ID             4
+#define LEN_ACTION              1
+#define LEN_TOPIC               15
+#define LEN_WEIGHT              3
+#define LEN_TOPIC_KEY           16  // LEN_TOPIC padded to two 64-bit words
+
+// Default rule set as (action, weight) pairs. It is expanded into the
+// RULE_ACTION/RULE_WEIGHT arrays in common.c, which rulesDefault copies
+// into the RULE_TABLE lookup.
+#define DEFAULT_RULES(X)        X('P', 50) X('L', 20) X('D', -10) X('C', 30) X('S', 40)
+#define _RULE_ONE(action, weight) + 1
+#define MAPPING_COUNT           (0 DEFAULT_RULES(_RULE_ONE))
+
+#define RULE_TABLE_SIZE         256         // one entry per action byte
+#define RULE_NONE               INT32_MIN   // RULE_TABLE entry for an unmapped action
+#define RULE_LINE_LENGTH        128
+
+// with N reducers the mapper writes partition i to this fd + i
+#define MAPPER_PARTITION_FD     3
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                            EXTERNS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+// The RULE_ACTIONS and RULE_WEIGHTS below define how each action is mapped
+// to the appropriate weight.
+extern const char RULE_ACTION[MAPPING_COUNT];
+extern const int32_t RULE_WEIGHT[MAPPING_COUNT];
+
+// RULE_TABLE[action] is the weight of that action, or RULE_NONE. It
+// is filled by rulesDefault at startup and replaced by rulesLoad.
+extern int32_t RULE_TABLE[RULE_TABLE_SIZE];
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                          PACKED KEYS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+// A user id packed into one word, so two ids compare in one instruction.
+typedef uint32_t user_key_t;
+
+// A topic padded with one space to LEN_TOPIC_KEY bytes, compared as two
+// 64-bit words. 'text' reads as the topic when printing.
+typedef union topicKey
+{
+    uint64_t word[2];
+    char text[LEN_TOPIC_KEY];
+} topic_key_t;
+
+static inline user_key_t userKey(const char* userid)
+{
+    user_key_t key;
+    memcpy(&key, userid, LEN_USER_ID);
+    return key;
+}
+
+// the user id read as a big endian number, so keys sort like the ids
+static inline uint32_t userKeyOrder(const char* userid)
+{
+    return ((uint32_t)(uint8_t)userid[0] << 24) | ((uint32_t)(uint8_t)userid[1] << 16) |
+           ((uint32_t)(uint8_t)userid[2] << 8) | (uint32_t)(uint8_t)userid[3];
+}
+
+static inline topic_key_t topicKey(const char* topic)
+{
+    topic_key_t key;
+    memcpy(key.text, topic, LEN_TOPIC);
+    key.text[LEN_TOPIC] = SPACE;
+    return key;
+}
+
+static inline int topicKeyEqual(const topic_key_t* a, const topic_key_t* b)
+{
+    return ((a->word[0] ^ b->word[0]) | (a->word[1] ^ b->word[1])) == 0;
+}
+
+// compares two unpadded LEN_TOPIC fields with two overlapping 8 byte loads
+static inline int topicEqual(const char* a, const char* b)
+{
+    uint64_t a0, a1, b0, b1;
+    memcpy(&a0, a, sizeof(a0));
+    memcpy(&a1, a + LEN_TOPIC - sizeof(a1), sizeof(a1));
+    memcpy(&b0, b, sizeof(b0));
+    memcpy(&b1, b + LEN_TOPIC - sizeof(b1), sizeof(b1));
+    return ((a0 ^ b0) | (a1 ^ b1)) == 0;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+int32_t console_string_read(char* store_string_location);
+void console_string_write(char* string, uint32_t len);
+void rulesDefault(void);
+int rulesLoad(const char* path);
+uint16_t debugger(char* string, uint16_t debugMode);
+uint32_t userPartition(char* userid, uint32_t numPartitions);
+
 #endif
\ No newline at end of file
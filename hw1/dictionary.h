@@ -1,38 +1,61 @@
-#ifndef _SRC_DICTIONARY_HEADER_
-#define _SRC_DICTIONARY_HEADER_
-
-#include <stdint.h>
-#include <stdio.h>
-#include <string.h>
-#include <stdlib.h>
-#include "common.h"
-
-#define DICTIONARY_DEBUG 0
-
-typedef struct node
-{   
-    // used for map initialization to determine if a valid key and
-    // value has been provided to the dictionary yet.
-    uint8_t valid;
-
-    char key[LEN_TOPIC];
-    int32_t value;   
-
-    // setting this struct up as a linked list allows it to 
-    // grow as needed without reallocating memory.
-    struct node * next;
-} node_t;
-
-/*
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
- *                           PROTOTYPES
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
- */
-
-node_t* dict();
-node_t* dictAddToValue(node_t* map, char* key, int32_t value);
-uint8_t dictCompareStrings(char* a, char* b);
-void dictFreeNodes(node_t * firstNode);
-void dictDisplayContents(node_t* firstNode);
-
+#ifndef _SRC_DICTIONARY_HEADER_
+#define _SRC_DICTIONARY_HEADER_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "common.h"
+
+#define DICTIONARY_DEBUG 0
+
+#define DICT_INIT_CAPACITY      16  // initial number of index buckets (power of 2)
+#define DICT_REHASH_STEP        4   // old buckets migrated per insert during a resize
+#define DICT_EMPTY              -1  // marks an unused index bucket
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           TYPEDEFS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+// One key/value slot. Slots are stored contiguously in insertion order
+// so the reducers can print topics in the order they were first seen.
+typedef struct entry
+{
+    uint32_t hash;          // precomputed hash of the key
+    int32_t value;
+    topic_key_t key;        // topic padded to LEN_TOPIC_KEY (see common.h)
+} entry_t;
+
+typedef struct dictionary
+{
+    // contiguous key/value slots, in insertion order
+    entry_t* entries;
+    uint32_t count;
+    uint32_t capacity;
+
+    // open addressing (linear probe) table of indices into 'entries'
+    int32_t* index;
+    uint32_t mask;
+
+    // while the index is growing, buckets are migrated from the old
+    // table a few at a time so no single insert pays for a full rehash.
+    int32_t* oldIndex;
+    uint32_t oldMask;
+    uint32_t rehashPos;
+} dict_t;
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+dict_t* dict();
+entry_t* dictAddToValue(dict_t* map, char* key, int32_t value);
+uint32_t dictHash(char* key);
+void dictFreeNodes(dict_t* map);
+void dictDisplayContents(dict_t* map);
+
 #endif
\ No newline at end of file
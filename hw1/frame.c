@@ -0,0 +1,264 @@
+/*
+ * SUMMARY: frame
+ * This file contains the binary protocol between the mapper and the
+ * reducer executables. Text mode formats every tuple as
+ * "(userid,topic,weight)" only for the reducer to parse it back a
+ * byte at a time. In binary mode ('-b' on both programs) the mapper
+ * writes fixed-size frame_record_t records instead, FRAME_BATCH_SIZE
+ * of them per write(2), and the reducer reads them back in batches.
+ *
+ * NOTE: A pipe may return part of a record at the end of a read. The
+ * partial record is moved to the front of the buffer and completed by
+ * the next read. frameRing swaps the pipe for the shared memory ring
+ * in ring.c, the batching is the same.
+ */
+
+#include <unistd.h>
+#include <errno.h>
+#include "frame.h"
+#include "ring.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                            DEFINES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+#define FRAME_BUF_BYTES     (FRAME_BATCH_SIZE * sizeof(frame_record_t))
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+static int _frameFill(frame_t* f);
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: frame
+ * allocate the record buffer for one end of the pipe 'fd'. The
+ * same structure is used for writing and reading, but one frame_t
+ * must only do one of the two.
+ *
+ * RETURN: 0 on success, -1 if the buffer cannot be allocated.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int frame(frame_t* f, int fd)
+{
+    f->fd = fd;
+    f->records = 0;
+    f->calls = 0;
+    f->_start = 0;
+    f->_len = 0;
+    f->_ring = NULL;
+    f->_buf = (frame_record_t*)malloc(FRAME_BUF_BYTES);
+    if (f->_buf == NULL)
+        return -1;
+
+    // connect functions
+    f->write = &frameWrite;
+    f->read = &frameRead;
+    return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: frameRing
+ * same as frame, but records go through the shared memory ring
+ * held by the memfd 'fd' (see ringCreate) instead of a pipe.
+ *
+ * RETURN: 0 on success, -1 if the ring cannot be mapped.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int frameRing(frame_t* f, int fd)
+{
+    if (frame(f, fd) == -1)
+        return -1;
+
+    f->_ring = ringMap(fd);
+    if (f->_ring == NULL)
+    {
+        frameDestruct(f);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: frameDestruct
+ * deallocate the buffer. A writer must call frameFlush first, queued
+ * records are dropped. The file descriptor is not closed.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void frameDestruct(frame_t* f)
+{
+    ringUnmap(f->_ring);
+    f->_ring = NULL;
+    free(f->_buf);
+    f->_buf = NULL;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: frameWrite -> connects to frame.write
+ * queue one record. Nothing reaches the pipe until FRAME_BATCH_SIZE
+ * records are queued or the frame is flushed.
+ *
+ * RETURN: 0 on success, -1 on a write error.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int frameWrite(frame_t* f, char* userid, char* topic, int32_t weight)
+{
+    frame_record_t* rec = (frame_record_t*)((char*)f->_buf + f->_len);
+
+    memcpy(rec->userid, userid, LEN_USER_ID);
+    memcpy(rec->topic, topic, LEN_TOPIC);
+    rec->weight = weight;
+    f->_len += sizeof(frame_record_t);
+    f->records++;
+
+    if (f->_len == FRAME_BUF_BYTES)
+        return frameFlush(f);
+    return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: frameFlush
+ * hand every queued record to the pipe, continuing after partial
+ * writes.
+ *
+ * RETURN: 0 on success, -1 on a write error.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int frameFlush(frame_t* f)
+{
+    char* data = (char*)f->_buf;
+    size_t done = 0;
+
+    if (f->_ring != NULL)
+    {
+        int error = ringWrite(f->_ring, f->_buf, f->_len / sizeof(frame_record_t));
+        f->_len = 0;
+        return error;
+    }
+
+    while (done < f->_len)
+    {
+        ssize_t len = write(f->fd, data + done, f->_len - done);
+        f->calls++;
+        if (len == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            f->_len = 0;
+            return -1;
+        }
+        done += len;
+    }
+
+    f->_len = 0;
+    return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: frameClose
+ * flush the writer's queued records and tell the reader there are
+ * no more. A pipe reader sees the end once the fd is closed, so
+ * only a ring needs marking.
+ *
+ * RETURN: 0 on success, -1 on a write error.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int frameClose(frame_t* f)
+{
+    int error = frameFlush(f);
+
+    if (f->_ring != NULL)
+        ringClose(f->_ring);
+    return error;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: frameRead -> connects to frame.read
+ * copies up to 'max' whole records into the caller's array. Only
+ * blocks on the pipe when no whole record is buffered.
+ *
+ * RETURN: number of records stored, 0 once the writer has closed
+ * the pipe, -1 on a read error or a truncated final record.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int frameRead(frame_t* f, frame_record_t* records, int max)
+{
+    if (f->_ring != NULL)
+    {
+        int count = ringRead(f->_ring, records, max);
+        f->records += count;
+        return count;
+    }
+
+    size_t whole = (f->_len - f->_start) / sizeof(frame_record_t);
+
+    if (whole == 0)
+    {
+        int error = _frameFill(f);
+        if (error <= 0)
+            return error;
+        whole = (f->_len - f->_start) / sizeof(frame_record_t);
+    }
+
+    if (whole > (size_t)max)
+        whole = max;
+
+    memcpy(records, (char*)f->_buf + f->_start, whole * sizeof(frame_record_t));
+    f->_start += whole * sizeof(frame_record_t);
+    f->records += whole;
+    return (int)whole;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _frameFill
+ * move a partial record to the front of the buffer and read(2)
+ * until at least one whole record is buffered.
+ *
+ * RETURN: 1 when a record is available, 0 at a clean end of the
+ * pipe, -1 on an error or if the pipe ends inside a record.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static int _frameFill(frame_t* f)
+{
+    char* data = (char*)f->_buf;
+    size_t left = f->_len - f->_start;
+
+    memmove(data, data + f->_start, left);
+    f->_start = 0;
+    f->_len = left;
+
+    while (f->_len < sizeof(frame_record_t))
+    {
+        ssize_t len = read(f->fd, data + f->_len, FRAME_BUF_BYTES - f->_len);
+        f->calls++;
+        if (len == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (len == 0)
+            return (f->_len == 0) ? 0 : -1;
+        f->_len += len;
+    }
+
+    return 1;
+}
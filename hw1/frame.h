@@ -0,0 +1,75 @@
+#ifndef _FRAME_SRC_HEADER_
+#define _FRAME_SRC_HEADER_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "common.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                            DEFINES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+#define FRAME_FLAG          "-b"    // command line flag that selects the binary protocol
+#define FRAME_BATCH_SIZE    2048    // records moved per read(2)/write(2)
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           TYPEDEFS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+// One mapper -> reducer record. Fixed size and packed so the reducer
+// can copy records straight out of the pipe without parsing text.
+// Both ends are built from the same tree on the same machine, so the
+// weight is kept in native byte order.
+typedef struct __attribute__((packed)) frameRecord
+{
+    char userid[LEN_USER_ID];   // USERID - 4 digit number
+    char topic[LEN_TOPIC];      // TOPIC - padded with spaces
+    int32_t weight;             // WEIGHT - already mapped from the action
+} frame_record_t;
+
+struct ringShared;
+
+// frame structure batches records on one end of a pipe. The writer
+// collects FRAME_BATCH_SIZE records before a write(2), the reader pulls
+// as many whole records as one read(2) returns. A frame built with
+// frameRing moves the same batches through a shared memory ring (ring.h)
+// instead of the pipe.
+typedef struct frameStruct
+{
+    // public parameters
+    int fd;                 // pipe end (STDIN_FILENO / STDOUT_FILENO)
+    uint64_t records;       // records written or read
+    uint64_t calls;         // read(2)/write(2) calls made
+
+    // functions
+    int (*write)(struct frameStruct* f, char* userid, char* topic, int32_t weight); // queue one record
+    int (*read)(struct frameStruct* f, frame_record_t* records, int max); // copy out up to max records
+
+    // private parameters
+    frame_record_t* _buf;
+    size_t _start;          // reader.. first byte not handed out yet
+    size_t _len;            // bytes of valid data in _buf
+    struct ringShared* _ring; // NULL for a pipe
+} frame_t;
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+int frame(frame_t* f, int fd);
+int frameRing(frame_t* f, int fd);
+void frameDestruct(frame_t* f);
+int frameWrite(frame_t* f, char* userid, char* topic, int32_t weight);
+int frameRead(frame_t* f, frame_record_t* records, int max);
+int frameFlush(frame_t* f);
+int frameClose(frame_t* f);
+
+#endif
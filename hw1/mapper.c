@@ -1,298 +1,250 @@
-#include <stdint.h>
-#include <stdio.h>
-#include <string.h>
-#include "common.h"
-
-/*
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
- *                           TYPEDEFS
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
- */
-
-typedef struct tupleIn 
-{
-    int8_t error;       // ERROR -  0 = tuple data is valid, 1 = There was an error while reading the tuple.
-    char userid[4];     // USERID - 4 digit number
-    char action;        // ACTION - Character to map using the rules defined in the 'main' summary.
-    char topic[15];     // TOPIC - Pad this with space if unused.
-
-} tupleIn_t;
-
-typedef struct tupleOut 
-{
-    int8_t error;       // ERROR -  0 = tuple data is valid, 1 = There was an error while reading the tuple.
-    char userid[4];     // USERID - 4 digit number
-    char topic[15];     // TOPIC - Pad this with space if unused.
-    int32_t weight;     // WEIGHT - Value mapped from the input action as defined by the set of rules in 'main' summary.
-
-} tupleOut_t;
-
-typedef enum tupleItem
-{
-    E_LEFT_BRACKET,
-    E_USER_ID,
-    E_ACTION,
-    E_TOPIC,
-    E_RIGHT_BRACKET
-} tupleItem_t;
-
-/*
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
- *                           PROTOTYPES
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
- */
-
-int32_t console_tuple_read(tupleIn_t * tuple_in);
-int32_t console_tuple_write(tupleOut_t * tuple_out, uint8_t firstPrint);
-int32_t map(tupleIn_t * in, tupleOut_t * out);
-
-/*
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
- *                           FUNCTIONS
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
- */
-
-/*
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
- * SUMMARY: console_tuple_read
- * This function creates an input tuple from an input string.
- * 
- * RETURN: 0 for valid data, -1 for error
- * 
- * EXAMPLE INPUT: "(1111,P,history)"
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
- */
-int32_t console_tuple_read(tupleIn_t * tuple)
-{
-    uint32_t        exitLoop    = 0;
-    int32_t         error       = 0;
-    uint32_t        charCount   = 0;
-    tupleItem_t     state       = E_LEFT_BRACKET;
-    char            nextChar    = getchar();
-
-    while(exitLoop != 1 && error != -1 && nextChar != ENTER)
-    {
-
-        switch(state)
-        {
-            // Wait for left bracket before reading into the tuple..
-            case E_LEFT_BRACKET:
-                if (nextChar == LB)
-                    state = E_USER_ID;
-                break;
-
-            // Add new characters to the user ID until comma is found
-            // OR exceeding max characters..
-            case E_USER_ID:
-
-                // comma found.. store future characters in the next state
-                if (nextChar == DELIMITER)
-                {
-                    state = E_ACTION;
-                    charCount = 0;
-                }
-                // comma not found and property length already used.. error on input.
-                else if (charCount == LEN_USER_ID)
-                {
-                    error = -1;
-                }
-                // store next character in the current property..
-                else
-                {
-                    tuple->userid[charCount] = nextChar;
-                    charCount++;
-                }
-
-                break;
-
-            // Add new characters to the action property until reaching 
-            // max characters OR comma is found..
-            case E_ACTION:
-
-                // comma found.. store future characters in the next state
-                if (nextChar == DELIMITER)
-                {
-                    state = E_TOPIC;
-                    charCount = 0;
-                }
-                // comma not found and property length already used.. error on input.
-                else if (charCount == LEN_ACTION)
-                {
-                    error = -1;
-                }
-                // store next character in the current property..
-                else
-                {
-                    tuple->action = nextChar;
-                    charCount++;
-                }
-
-                break;
-
-            // Add new characters to the topic until the right bracket is
-            // found. Then fill in the remainder of the characters with null
-            // characters and exit..
-            case E_TOPIC:
-
-                // Tuple is complete when the right bracket has been found. Fill
-                // in the empty values with spaces
-                if (nextChar == RB)
-                {
-                    exitLoop = 1;
-                    for (; charCount < LEN_TOPIC; charCount++)
-                        tuple->topic[charCount] = SPACE;
-                }
-                // reached max topic length.. throw an error.
-                else if (charCount == LEN_TOPIC)
-                {
-                    error = -1;
-                }
-                // new character to add to the tuple's topic property.
-                else
-                {
-                    tuple->topic[charCount] = nextChar;
-                    charCount++;
-                }
-                break;
-
-            default:
-                printf("ERROR: Should not be entering this case..");  
-                break;  
-        } 
-
-        nextChar = getchar();
-
-        // exit the function if the EOF is found
-        if (nextChar == -1)
-        {
-            if (feof(stdin))
-                error = -1;
-        }
-    }
-
-    return error;
-}
-
-/*
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
- * SUMMARY: console_tuple_write
- * This function creates an output string from an output tuple.
- * 
- * RETURN: 0 for valid data, -1 for error
- * 
- * EXAMPLE OUTPUT: "(1111,history,50)"
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
- */
-int32_t console_tuple_write(tupleOut_t * tuple, uint8_t firstPrint)
-{
-    if (tuple->error == 0)
-    {
-        // convert integer weight into printable string
-        char weightString[3];
-        weightString[2] = '\0'; // in case only 2 characters are required
-        sprintf(weightString, "%d", tuple->weight);
-
-        // delimiter for separate tuples.
-        if (!firstPrint)
-            putchar(DELIMITER);
-
-        // print out the tuple in the expected format..
-        putchar(LB);
-        console_string_write(tuple->userid, sizeof(tuple->userid));
-        putchar(DELIMITER);
-        console_string_write(tuple->topic, sizeof(tuple->topic));
-        putchar(DELIMITER);
-        //console_string_write(weightString, sizeof(weightString));
-        printf("%s", weightString);
-        putchar(RB);
-        
-        return 0;
-    }
-    else
-        return -1;
-}
-
-/*
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
- * SUMMARY: console_tuple_write
- * This function maps the input action to the output weight.
- * Additionally, it deep copies the data from the input tuple
- * to the output tuple.
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
- */
-int32_t map(tupleIn_t * in, tupleOut_t * out)
-{
-    uint8_t index;
-    for (index = 0; index < MAPPING_COUNT; index++)
-    {
-        // action used was found.. mark as successful and 
-        // create the mapping. 
-        if (in->action == RULE_ACTION[index])
-        {
-            out->error = 0;
-            out->weight = RULE_WEIGHT[index];
-            break;
-        }
-
-        // if the action was not found, mark as  an error (hopefully temporarily)
-        // and continue the search.
-        else
-        {
-            out->error = -1;
-        }
-    }
-
-    // if the action search was successful, perform a deep copy from the
-    // inputs to the outputs on all other items.
-    if (out->error == 0)
-    {
-        // copy TOPIC
-        for (uint32_t i = 0; i < sizeof(in->topic); i++)
-            out->topic[i] = in->topic[i];
-
-        // copy USER ID
-        for (uint32_t i = 0; i < sizeof(in->userid); i++)
-            out->userid[i] = in->userid[i];
-
-        return 0;
-    }
-    else
-        return -1;
-}
-
-/*
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
- * SUMMARY: main
- * This function maps an input tuple into a different tuple
- * using the rules defined below. The generated tuple is immediately
- * output to the terminal.
- * 
- * RULES:
- * P = 50, L = 20, D = -10, C = 30, S = 40
- * 
- * EXAMPlE INPUT:   (1111,P,history)
- * EXAMPLE OUTPUT:  (1111,history,50)
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
- */
-int main (void)
-{
-    tupleOut_t outputTuple;
-    tupleIn_t inputTuple;
-    int32_t error = 0;
-    uint8_t firstPrint = 1;
-
-    while (!error)
-    {
-        // get data from the std input
-        error = console_tuple_read(&inputTuple);
-
-        // map the data to the output tuple and output
-        map(&inputTuple, &outputTuple);
-
-        // output new tuple to the std output
-        console_tuple_write(&outputTuple, firstPrint);
-        firstPrint = 0; // do always print comma before tuple in future iterations
-    }  
-    
-    return 0;
-}
\ No newline at end of file
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "common.h"
+#include "parser.h"
+#include "frame.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           TYPEDEFS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+typedef struct tupleOut 
+{
+    int8_t error;       // ERROR -  0 = tuple data is valid, 1 = There was an error while reading the tuple.
+    char userid[4];     // USERID - 4 digit number
+    char topic[15];     // TOPIC - Pad this with space if unused.
+    int32_t weight;     // WEIGHT - Value mapped from the input action as defined by the set of rules in 'main' summary.
+
+} tupleOut_t;
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+int32_t console_tuple_write(FILE* stream, tupleOut_t * tuple_out, uint8_t firstPrint);
+int32_t map(tupleIn_t * in, tupleOut_t * out);
+int mapBatch(tupleIn_t* in, tupleOut_t* out, int n);
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: console_tuple_write
+ * This function creates an output string from an output tuple
+ * on 'stream' (stdout, or a partition's pipe with -r).
+ * 
+ * RETURN: 0 for valid data, -1 for error
+ * 
+ * EXAMPLE OUTPUT: "(1111,history,50)"
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int32_t console_tuple_write(FILE* stream, tupleOut_t * tuple, uint8_t firstPrint)
+{
+    if (tuple->error == 0)
+    {
+        // convert integer weight into printable string
+        char weightString[LEN_WEIGHT + 1]; // room for "-10" + null
+        snprintf(weightString, sizeof(weightString), "%d", tuple->weight);
+
+        // delimiter for separate tuples.
+        if (!firstPrint)
+            putc(DELIMITER, stream);
+
+        // print out the tuple in the expected format..
+        putc(LB, stream);
+        fwrite(tuple->userid, 1, sizeof(tuple->userid), stream);
+        putc(DELIMITER, stream);
+        fwrite(tuple->topic, 1, sizeof(tuple->topic), stream);
+        putc(DELIMITER, stream);
+        fputs(weightString, stream);
+        putc(RB, stream);
+        
+        return 0;
+    }
+    else
+        return -1;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: map
+ * This function maps the input action to the output weight with
+ * a single RULE_TABLE lookup. Additionally, it deep copies the
+ * data from the input tuple to the output tuple.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int32_t map(tupleIn_t * in, tupleOut_t * out)
+{
+    int32_t weight = RULE_TABLE[(uint8_t)in->action];
+
+    out->error = (weight == RULE_NONE) ? -1 : 0;
+    out->weight = weight;
+    memcpy(out->topic, in->topic, sizeof(out->topic));
+    memcpy(out->userid, in->userid, sizeof(out->userid));
+
+    return out->error;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: mapBatch
+ * This function maps 'n' parsed tuples in one pass and packs the
+ * valid ones at the front of 'out' (room for 'n' tuples). Every
+ * tuple is copied and the output index only moves forward for a
+ * known action, so there is no branch on the data in the loop.
+ * 
+ * RETURN: number of valid tuples in 'out'
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int mapBatch(tupleIn_t* in, tupleOut_t* out, int n)
+{
+    int count = 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        int32_t weight = RULE_TABLE[(uint8_t)in[i].action];
+        tupleOut_t* next = &out[count];
+
+        next->error = 0;
+        next->weight = weight;
+        memcpy(next->topic, in[i].topic, sizeof(next->topic));
+        memcpy(next->userid, in[i].userid, sizeof(next->userid));
+        count += (weight != RULE_NONE);
+    }
+
+    return count;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: main
+ * This function maps an input tuple into a different tuple
+ * using the rules defined below. The generated tuple is immediately
+ * output to the terminal.
+ * 
+ * RULES:
+ * P = 50, L = 20, D = -10, C = 30, S = 40
+ * 
+ * EXAMPlE INPUT:   (1111,P,history)
+ * EXAMPLE OUTPUT:  (1111,history,50)
+ *
+ * OPTIONS:
+ * -b   write packed binary records (frame.h) instead of text. The
+ *      reducer must be started with -b as well.
+ * -s   write binary records into a shared memory ring (ring.h). The
+ *      output fds must be memfds from ringCreate, and the reducer must
+ *      be started with -s as well.
+ * -r N split the output into N partitions by user id hash. Partition
+ *      i is written to file descriptor MAPPER_PARTITION_FD + i, which
+ *      the combiner connects to reducer i.
+ * -w file  load the rules from 'file' instead ("action weight" per
+ *      line, see rulesLoad).
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+int main (int argc, char** argv)
+{
+    tupleOut_t outputTuples[PARSER_BATCH_SIZE];
+    tupleIn_t inputTuples[PARSER_BATCH_SIZE];
+    parser_t input;
+    int numTuples;
+    int numPartitions = 1;
+    int binary = 0;
+    int shared = 0;
+    int opt;
+
+    rulesDefault();
+    while ((opt = getopt(argc, argv, "bsr:w:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'b': binary = 1; break;
+            case 's': binary = shared = 1; break;
+            case 'r': numPartitions = atoi(optarg); break;
+            case 'w': if (rulesLoad(optarg) == -1) return -1; break;
+            default: numPartitions = -1; break;
+        }
+    }
+
+    if (numPartitions < 1)
+    {
+        fprintf(stderr, "ERROR: Expecting ./mapper [-b | -s] [-r partitions] [-w rules]\n");
+        return -1;
+    }
+
+    // read the std input in large blocks instead of a character at a time
+    if (parser(&input, STDIN_FILENO) == -1)
+        return -1;
+
+    // one output per partition.. a single partition is the std output
+    frame_t frames[numPartitions];
+    FILE* streams[numPartitions];
+    uint8_t firstPrint[numPartitions];
+
+    for (int p = 0; p < numPartitions; p++)
+    {
+        int fd = (numPartitions == 1) ? STDOUT_FILENO : MAPPER_PARTITION_FD + p;
+
+        firstPrint[p] = 1;
+        if (binary)
+        {
+            if ((shared ? frameRing(&frames[p], fd) : frame(&frames[p], fd)) == -1)
+                return -1;
+        }
+        else
+        {
+            streams[p] = (numPartitions == 1) ? stdout : fdopen(fd, "w");
+            if (streams[p] == NULL)
+                return -1;
+        }
+    }
+
+    while ((numTuples = input.read(&input, inputTuples, PARSER_BATCH_SIZE)) > 0)
+    {
+        // map the whole batch.. unknown actions are dropped
+        numTuples = mapBatch(inputTuples, outputTuples, numTuples);
+
+        for (int i = 0; i < numTuples; i++)
+        {
+            tupleOut_t* outputTuple = &outputTuples[i];
+            int p = (numPartitions == 1) ? 0 : userPartition(outputTuple->userid, numPartitions);
+
+            // binary mode.. no formatting, records go out in batches
+            if (binary)
+                frames[p].write(&frames[p], outputTuple->userid, outputTuple->topic, outputTuple->weight);
+
+            // output new tuple to the partition's stream
+            else if (console_tuple_write(streams[p], outputTuple, firstPrint[p]) == 0)
+                firstPrint[p] = 0; // do always print comma before tuple in future iterations
+        }
+    }  
+
+    for (int p = 0; p < numPartitions; p++)
+    {
+        if (binary)
+        {
+            frameClose(&frames[p]);
+            frameDestruct(&frames[p]);
+        }
+        else
+        {
+            // end the tuple list with a newline, like Mapper_Output.txt
+            if (!firstPrint[p])
+                putc(ENTER, streams[p]);
+            fflush(streams[p]);
+        }
+    }
+
+    parserDestruct(&input);
+    return 0;
+}
@@ -0,0 +1,271 @@
+/*
+ * SUMMARY: ring
+ * This file contains the shared memory transport between the mapper
+ * and the reducer executables. A pipe costs a write(2) and a read(2)
+ * per batch and copies every record through the kernel twice. The
+ * ring is a memfd mapped by both processes, so records are copied
+ * straight into the reader's view of the buffer.
+ *
+ * NOTE: Each side only sleeps on a futex when the ring is empty (reader)
+ * or full (writer). The other side only makes the FUTEX_WAKE syscall
+ * when it sees the waiting flag, so a busy pipeline never enters the
+ * kernel.
+ */
+
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "ring.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                            DEFINES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+#define RING_BYTES  (sizeof(ring_shared_t) + RING_RECORDS * sizeof(frame_record_t))
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+static void _ringWait(atomic_uint* seq, uint32_t value);
+static void _ringWake(atomic_uint* seq);
+static int _ringEmpty(ring_shared_t* ring);
+static int _ringFull(ring_shared_t* ring);
+static void _ringSleep(ring_shared_t* ring, atomic_uint* seq, atomic_int* waiting, int (*mustWait)(ring_shared_t*));
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: ringCreate
+ * create an empty ring in a new memfd. The fd is inherited across
+ * fork and exec, the caller dup2s it to where the child expects it.
+ *
+ * RETURN: the memfd, -1 on error.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int ringCreate(void)
+{
+    int fd = memfd_create("ring", 0);
+    if (fd == -1)
+        return -1;
+
+    if (ftruncate(fd, RING_BYTES) == -1)
+    {
+        close(fd);
+        return -1;
+    }
+
+    // a new memfd is zero filled, so only the mask needs setting
+    ring_shared_t* ring = ringMap(fd);
+    if (ring == NULL)
+    {
+        close(fd);
+        return -1;
+    }
+    ring->mask = RING_RECORDS - 1;
+    ringUnmap(ring);
+
+    return fd;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: ringMap
+ * map the ring held by 'fd' into this process.
+ *
+ * RETURN: the ring, NULL on error.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+ring_shared_t* ringMap(int fd)
+{
+    void* addr = mmap(NULL, RING_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    return (addr == MAP_FAILED) ? NULL : (ring_shared_t*)addr;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: ringUnmap
+ * remove this process' mapping of the ring. The memory is freed
+ * once every process has unmapped it and closed the fd.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void ringUnmap(ring_shared_t* ring)
+{
+    if (ring != NULL)
+        munmap(ring, RING_BYTES);
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: ringWrite
+ * copy all 'n' records into the ring, sleeping while it is full.
+ * Only one process may write to a ring.
+ *
+ * RETURN: 0 on success, -1 if the ring was closed.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int ringWrite(ring_shared_t* ring, frame_record_t* records, int n)
+{
+    uint32_t size = ring->mask + 1;
+
+    while (n > 0)
+    {
+        uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        uint32_t space = size - (head - tail);
+
+        if (atomic_load_explicit(&ring->closed, memory_order_relaxed))
+            return -1;
+
+        if (space == 0)
+        {
+            _ringSleep(ring, &ring->spaceSeq, &ring->writerWaiting, &_ringFull);
+            continue;
+        }
+
+        // copy up to the end of the buffer, then wrap to the front
+        uint32_t count = (space < (uint32_t)n) ? space : (uint32_t)n;
+        uint32_t start = head & ring->mask;
+        uint32_t first = (count < size - start) ? count : size - start;
+        memcpy(&ring->records[start], records, first * sizeof(frame_record_t));
+        memcpy(&ring->records[0], records + first, (count - first) * sizeof(frame_record_t));
+
+        atomic_store_explicit(&ring->head, head + count, memory_order_release);
+        records += count;
+        n -= count;
+
+        // pairs with the fence in _ringSleep
+        atomic_thread_fence(memory_order_seq_cst);
+        if (atomic_load_explicit(&ring->readerWaiting, memory_order_relaxed))
+            _ringWake(&ring->dataSeq);
+    }
+
+    return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: ringRead
+ * copy 1..max records out of the ring, sleeping while it is empty.
+ * Only one process may read from a ring.
+ *
+ * RETURN: number of records stored, 0 once the ring is closed and
+ * empty.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int ringRead(ring_shared_t* ring, frame_record_t* records, int max)
+{
+    uint32_t size = ring->mask + 1;
+
+    while (1)
+    {
+        uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+        if (head == tail)
+        {
+            // the writer publishes its last records before closing
+            if (atomic_load_explicit(&ring->closed, memory_order_acquire) &&
+                atomic_load_explicit(&ring->head, memory_order_acquire) == tail)
+                return 0;
+
+            _ringSleep(ring, &ring->dataSeq, &ring->readerWaiting, &_ringEmpty);
+            continue;
+        }
+
+        uint32_t count = (head - tail < (uint32_t)max) ? head - tail : (uint32_t)max;
+        uint32_t start = tail & ring->mask;
+        uint32_t first = (count < size - start) ? count : size - start;
+        memcpy(records, &ring->records[start], first * sizeof(frame_record_t));
+        memcpy(records + first, &ring->records[0], (count - first) * sizeof(frame_record_t));
+
+        atomic_store_explicit(&ring->tail, tail + count, memory_order_release);
+
+        // pairs with the fence in _ringSleep
+        atomic_thread_fence(memory_order_seq_cst);
+        if (atomic_load_explicit(&ring->writerWaiting, memory_order_relaxed))
+            _ringWake(&ring->spaceSeq);
+
+        return (int)count;
+    }
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: ringClose
+ * no more records.. wakes up the reader. Called by the mapper when
+ * it is done, and again by the combiner once the mapper has exited
+ * so a crashed mapper can't leave a reducer asleep.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void ringClose(ring_shared_t* ring)
+{
+    atomic_store_explicit(&ring->closed, 1, memory_order_release);
+    atomic_thread_fence(memory_order_seq_cst);
+    _ringWake(&ring->dataSeq);
+    _ringWake(&ring->spaceSeq);
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _ringSleep
+ * put the caller to sleep on 'seq' until the other side bumps it.
+ * 'mustWait' is checked again after the waiting flag is raised, so
+ * either the other side sees the flag or this side sees its update.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static void _ringSleep(ring_shared_t* ring, atomic_uint* seq, atomic_int* waiting, int (*mustWait)(ring_shared_t*))
+{
+    uint32_t value = atomic_load_explicit(seq, memory_order_acquire);
+
+    atomic_store_explicit(waiting, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (mustWait(ring) && !atomic_load_explicit(&ring->closed, memory_order_acquire))
+        _ringWait(seq, value);
+
+    atomic_store_explicit(waiting, 0, memory_order_relaxed);
+}
+
+// reader's wait condition
+static int _ringEmpty(ring_shared_t* ring)
+{
+    return atomic_load(&ring->head) == atomic_load(&ring->tail);
+}
+
+// writer's wait condition
+static int _ringFull(ring_shared_t* ring)
+{
+    return atomic_load(&ring->head) - atomic_load(&ring->tail) == ring->mask + 1;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _ringWait / _ringWake
+ * futex wrappers. FUTEX_WAIT returns at once if '*seq' no longer
+ * holds 'value', which is how a wake that came early is noticed.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static void _ringWait(atomic_uint* seq, uint32_t value)
+{
+    syscall(SYS_futex, (uint32_t*)seq, FUTEX_WAIT, value, NULL, NULL, 0);
+}
+
+static void _ringWake(atomic_uint* seq)
+{
+    atomic_fetch_add_explicit(seq, 1, memory_order_release);
+    syscall(SYS_futex, (uint32_t*)seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
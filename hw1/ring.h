@@ -0,0 +1,66 @@
+#ifndef _RING_SRC_HEADER_
+#define _RING_SRC_HEADER_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include "common.h"
+#include "frame.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                            DEFINES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+#define RING_FLAG           "-s"        // command line flag that selects the shared memory ring
+#define RING_RECORDS        (1 << 16)   // records per ring (power of 2)
+#define CACHE_LINE_SIZE     64
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           TYPEDEFS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+// Single-producer/single-consumer ring of frame records that lives in
+// a memfd. The combiner creates it before fork and the exec'd mapper
+// and reducer map the inherited fd. Records move without a syscall,
+// futexes are only used to put an idle side to sleep. The futex words
+// are process shared, so FUTEX_PRIVATE_FLAG must not be used.
+typedef struct ringShared
+{
+    // producer side.. written by the mapper only
+    _Alignas(CACHE_LINE_SIZE) atomic_uint head;
+
+    // consumer side.. written by the reducer only
+    _Alignas(CACHE_LINE_SIZE) atomic_uint tail;
+
+    // sleep/wake state.. a sequence word is bumped before each wake so
+    // a wake between the check and FUTEX_WAIT is never lost.
+    _Alignas(CACHE_LINE_SIZE) atomic_uint dataSeq;   // reader sleeps here
+    atomic_uint spaceSeq;                            // writer sleeps here
+    atomic_int readerWaiting;
+    atomic_int writerWaiting;
+    atomic_int closed;
+    uint32_t mask;
+
+    _Alignas(CACHE_LINE_SIZE) frame_record_t records[];
+} ring_shared_t;
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+int ringCreate(void);
+ring_shared_t* ringMap(int fd);
+void ringUnmap(ring_shared_t* ring);
+int ringWrite(ring_shared_t* ring, frame_record_t* records, int n);
+int ringRead(ring_shared_t* ring, frame_record_t* records, int max);
+void ringClose(ring_shared_t* ring);
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ * SUMMARY: affinity
+ * This file contains the CPU pinning used by the combiner's -a option.
+ * A list such as "0-3,8,10-11" is parsed once, and every thread is then
+ * created with attributes that bind it to the CPU of its slot.
+ *
+ * NOTE: Memory is placed by first touch (the Linux default policy), so
+ * a buffer lands on the NUMA node of the thread that writes it first.
+ * The reducers re-allocate their channel rings and output buffers once
+ * they run on their own CPU (see channelPlace and outputPlace), which
+ * puts them on the consumer's node without linking against libnuma.
+ */
+
+#define _GNU_SOURCE   // cpu_set_t + pthread_attr_setaffinity_np
+#include <sched.h>
+#include <ctype.h>
+#include "affinity.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: affinity
+ * parse a comma separated list of CPUs and CPU ranges ("0-3,8").
+ * 'list' may be NULL, which leaves every thread unpinned.
+ *
+ * NOTE: Returns -1 if the list is malformed or names a CPU this
+ * process is not allowed to run on.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+int affinity(affinity_t* a, const char* list)
+{
+  a->numCpus = 0;
+
+  // connect functions
+  a->attr = &affinityAttr;
+
+  if (list == NULL)
+    return 0;
+
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    return -1;
+
+  const char* p = list;
+  while (*p != '\0')
+  {
+    char* end;
+    if (!isdigit((unsigned char)*p))
+      return -1;
+    long first = strtol(p, &end, 10);
+    long last = first;
+    p = end;
+
+    if (*p == '-')
+    {
+      p++;
+      if (!isdigit((unsigned char)*p))
+        return -1;
+      last = strtol(p, &end, 10);
+      p = end;
+    }
+
+    if (last < first || last >= CPU_SETSIZE)
+      return -1;
+
+    for (long cpu = first; cpu <= last; cpu++)
+    {
+      if (!CPU_ISSET(cpu, &allowed) || a->numCpus == AFFINITY_MAX_CPUS)
+        return -1;
+      a->cpus[a->numCpus++] = (int)cpu;
+    }
+
+    if (*p == ',')
+      p++;
+    else if (*p != '\0')
+      return -1;
+  }
+
+  return (a->numCpus > 0) ? 0 : -1;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: affinityAttr -> connects to affinity.attr
+ * initialize 'attr' for the thread of the selected slot. The caller
+ * destroys it with pthread_attr_destroy once the thread is created.
+ *
+ * NOTE: Returns -1 if the attributes cannot be set.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+int affinityAttr(affinity_t* a, int slot, pthread_attr_t* attr)
+{
+  if (pthread_attr_init(attr) != 0)
+    return -1;
+
+  if (a->numCpus == 0)
+    return 0;
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(a->cpus[slot % a->numCpus], &set);
+  if (pthread_attr_setaffinity_np(attr, sizeof(set), &set) != 0)
+  {
+    pthread_attr_destroy(attr);
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,49 @@
+#ifndef _AFFINITY_SRC_HEADER_
+#define _AFFINITY_SRC_HEADER_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "common.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      DEFINES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+#define AFFINITY_MAX_CPUS   256   // longest cpu list accepted by -a
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      TYPEDEFS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+// affinity structure holds the CPUs the combiner's threads are pinned
+// to. Thread slot i runs on cpus[i % numCpus], so a list shorter than
+// the number of threads wraps around. Without a list (numCpus == 0)
+// threads are left to the scheduler.
+typedef struct affinityStruct
+{
+  // public parameters
+  int numCpus;
+  int cpus[AFFINITY_MAX_CPUS];
+
+  // functions
+  int (*attr)(struct affinityStruct* a, int slot, pthread_attr_t* attr); // thread attributes for a slot
+
+} affinity_t;
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+int affinity(affinity_t* a, const char* list);
+int affinityAttr(affinity_t* a, int slot, pthread_attr_t* attr);
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ * SUMMARY: aggregate
+ * This file contains the mapper side pre-aggregation (combiner) stage.
+ * The reducer only sums weights per (userid, topic), so the mapper can
+ * do part of that sum before anything crosses a channel.
+ *
+ * NOTE: The table only ever holds one user. The input is grouped by
+ * user, so the table is drained when the user changes (or when it is
+ * full, or at EOF) and the drained partial sums are routed together.
+ * Draining in first seen order keeps the reducer's topic order the same
+ * as without pre-aggregation, so the output does not change.
+ */
+
+#include "aggregate.h"
+#include "dictionary.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+static void _aggregateClear(aggregate_t* a);
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: aggregate
+ * initialize an empty pre-aggregation table.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int aggregate(aggregate_t* a)
+{
+  a->tuplesIn = 0;
+  a->tuplesOut = 0;
+  _aggregateClear(a);
+
+  // connect functions
+  a->add = &aggregateAdd;
+  a->drain = &aggregateDrain;
+  return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: aggregateAdd -> connects to aggregate.add
+ * adds the tuple's weight to the partial sum of its topic. A topic
+ * seen for the first time gets a new partial sum.
+ *
+ * NOTE: Returns -1 without adding anything if the tuple belongs to a
+ * different user or the table is full. The caller drains the table
+ * and adds the tuple again.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int aggregateAdd(aggregate_t* a, mTupleOut_t* tuple)
+{
+  if (a->_count > 0 && userKey(a->_sums[0].userid) != userKey(tuple->userid))
+    return -1;
+
+  uint32_t slot = dictHash(tuple->topic) & (AGGREGATE_SLOTS - 1);
+  while (a->_index[slot] != AGGREGATE_EMPTY)
+  {
+    mTupleOut_t* sum = &a->_sums[a->_index[slot]];
+    if (topicEqual(sum->topic, tuple->topic))
+    {
+      sum->weight += tuple->weight;
+      a->tuplesIn++;
+      return 0;
+    }
+    slot = (slot + 1) & (AGGREGATE_SLOTS - 1);
+  }
+
+  if (a->_count == AGGREGATE_MAX_TOPICS)
+    return -1;
+
+  a->_index[slot] = (int8_t)a->_count;
+  a->_sums[a->_count++] = *tuple;
+  a->tuplesIn++;
+  return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: aggregateDrain -> connects to aggregate.drain
+ * points '*tuples' at the partial sums (first seen order) and empties
+ * the table. The tuples stay valid until the next add.
+ *
+ * RETURN: number of partial sums, all for the same user.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int aggregateDrain(aggregate_t* a, mTupleOut_t** tuples)
+{
+  int count = a->_count;
+
+  *tuples = a->_sums;
+  a->tuplesOut += count;
+  _aggregateClear(a);
+  return count;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: aggregateCount
+ * returns the number of partial sums waiting to be drained.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int aggregateCount(aggregate_t* a)
+{
+  return a->_count;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      PRIVATE FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _aggregateClear
+ * empties the table. The partial sums themselves are left in place
+ * for the caller that just drained them.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static void _aggregateClear(aggregate_t* a)
+{
+  a->_count = 0;
+  memset(a->_index, AGGREGATE_EMPTY, sizeof(a->_index));
+}
@@ -0,0 +1,59 @@
+#ifndef _AGGREGATE_SRC_HEADER_
+#define _AGGREGATE_SRC_HEADER_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "common.h"
+#include "mapper.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      DEFINES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+#define AGGREGATE_MAX_TOPICS  32  // partial sums held before the table is drained
+#define AGGREGATE_SLOTS       64  // topic index slots (power of 2, load <= 1/2)
+#define AGGREGATE_EMPTY       -1  // marks an unused index slot
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      TYPEDEFS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+// aggregate structure is a mapper side pre-aggregation table. It sums
+// the weights of one user's tuples per topic, so only one tuple per
+// (userid, topic) crosses the channel instead of one per action. The
+// partial sums are kept in the order the topics were first seen, which
+// is the order the reducer prints them in.
+typedef struct aggregateStruct
+{
+  // public parameters
+  uint64_t tuplesIn;    // mapped tuples added
+  uint64_t tuplesOut;   // partial sums drained
+
+  // functions
+  int (*add)(struct aggregateStruct* a, mTupleOut_t* tuple);      // -1 if the table must be drained first
+  int (*drain)(struct aggregateStruct* a, mTupleOut_t** tuples);  // hands out the partial sums, empties the table
+
+  // private parameters
+  int _count;                               // partial sums in _sums
+  mTupleOut_t _sums[AGGREGATE_MAX_TOPICS];  // in first seen order, all for one user
+  int8_t _index[AGGREGATE_SLOTS];           // topic hash -> position in _sums
+} aggregate_t;
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+int aggregate(aggregate_t* a);
+int aggregateAdd(aggregate_t* a, mTupleOut_t* tuple);
+int aggregateDrain(aggregate_t* a, mTupleOut_t** tuples);
+int aggregateCount(aggregate_t* a);
+
+#endif
@@ -2,10 +2,47 @@
  * SUMMARY: channel
  * This file contains functions to read/write/initialize a SINGLE channel
  * (NOT A CHANNEL ARRAY).
+ *
+ * NOTE: A channel is a lock-free single-producer/single-consumer ring.
+ * The writer publishes a tuple by storing _head with release ordering
+ * and the reader frees a slot by storing _tail with release ordering,
+ * so each side only ever writes its own index.
+ *
+ * NOTE: The *Wait functions sleep on a condition variable instead of
+ * polling. A side that is about to sleep raises its 'waiting' flag and
+ * re-checks the ring; the other side checks that flag after every index
+ * update. A seq_cst fence on both sides guarantees at least one of them
+ * sees the other, so a wakeup is never lost.
+ *
+ * NOTE: read_batch/write_batch move several tuples per index update, so
+ * the release store, the cache line transfer of the index and the wake
+ * check are paid once per batch instead of once per tuple.
+ *
+ * NOTE: A reader that owns several channels (one per mapper) attaches
+ * them to one bell and reads with channelReadAny. Blocking on one of
+ * its channels at a time could deadlock: the mapper it waits for may be
+ * stuck on a full ring of another reducer that waits for a third mapper.
+ *
+ * NOTE: Several threads can sleep on one bell (see steal.c), so a bell
+ * counts its sleepers and every ring wakes all of them.
  */
 
 #include "channel.h"
 
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+static void _channelWake(channel_t* ch, atomic_int* waiting, pthread_cond_t* cond);
+static int _channelReadMany(channel_t* ch, mTupleOut_t* tuples, int n);
+static int _channelWriteMany(channel_t* ch, mTupleOut_t* tuples, int n);
+static int _channelSleepReader(channel_t* ch);
+static int _channelSleepWriter(channel_t* ch);
+static void _channelRingBell(channel_bell_t* bell);
+static int _channelAnyReady(channel_t** chs, int n);
+
 /*
  * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
  *                      FUNCTIONS
@@ -15,8 +52,10 @@
 /*
  * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
  * SUMMARY: channel
- * set the size of the tuple array + max + init pointers for the 
+ * set the size of the tuple ring + max + init indices for the
  * selected channel.
+ *
+ * NOTE: Returns -1 if the ring cannot be allocated.
  * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
  */
 int channel(channel_t* ch, int size)
@@ -25,84 +64,431 @@ int channel(channel_t* ch, int size)
   for (int i = 0; i < LEN_USER_ID; i++)
     ch->userid[i] = '\0';
 
+  if (size <= 0)
+    return -1;
+
+  // round the ring up to a power of 2 so indices can be masked. The
+  // channel still only holds 'size' tuples at a time.
+  uint32_t slots = 1;
+  while (slots < (uint32_t)size)
+    slots <<= 1;
+
   ch->max = size;
-  ch->count = 0;
+  ch->_mask = slots - 1;
+  ch->_ring = (mTupleOut_t*)malloc(slots*sizeof(mTupleOut_t));
+  if (ch->_ring == NULL)
+    return -1;
+
+  atomic_init(&ch->_head, 0);
+  atomic_init(&ch->_tail, 0);
+  ch->_cachedHead = 0;
+  ch->_cachedTail = 0;
+
+  atomic_init(&ch->_readerWaiting, 0);
+  atomic_init(&ch->_writerWaiting, 0);
+  atomic_init(&ch->_closed, 0);
+  pthread_mutex_init(&ch->_mutex, NULL);
+  pthread_cond_init(&ch->_notEmpty, NULL);
+  pthread_cond_init(&ch->_notFull, NULL);
+  ch->_bell = NULL;
 
-  ch->head = NULL;
-  ch->tail = NULL;
-  
   // connect functions
   ch->set_userid = &channelSetUserId;
   ch->write = &channelWriteTuple;
   ch->read = &channelReadTuple;
+  ch->write_wait = &channelWriteTupleWait;
+  ch->read_wait = &channelReadTupleWait;
+  ch->write_batch = &channelWriteBatch;
+  ch->read_batch = &channelReadBatch;
+  ch->try_read_batch = &channelTryReadBatch;
+  ch->close = &channelClose;
   return 0;
 }
 
 /*
  * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
- * SUMMARY: channelReadTuple -> connects to channel.read
- * reads the next tuple and increments read pointer
+ * SUMMARY: channelDestruct
+ * deallocate the tuple ring of the selected channel.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+void channelDestruct(channel_t* ch)
+{
+  free(ch->_ring);
+  ch->_ring = NULL;
+
+  pthread_mutex_destroy(&ch->_mutex);
+  pthread_cond_destroy(&ch->_notEmpty);
+  pthread_cond_destroy(&ch->_notFull);
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: channelPlace
+ * re-allocate the tuple ring from the calling thread and touch every
+ * page, so the ring lives on that thread's NUMA node (first touch).
+ * Called by the reader before anything is written to the channel.
  *
- * NOTE: Returns NULL if the buffer is EMPTY.
+ * NOTE: Returns -1 if the new ring cannot be allocated.. the old one
+ * is kept then.
  * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
  */
-mTupleOut_t* channelReadTuple(channel_t* ch)
+int channelPlace(channel_t* ch)
 {
-  // detach tail and relink list
-  if (ch->count > 0)
-  {
-    mTupleOut_t* oldTail = ch->tail;
-    mTupleOut_t* newTail = ch->tail->prev;
+  size_t bytes = (size_t)(ch->_mask + 1)*sizeof(mTupleOut_t);
+  mTupleOut_t* ring = (mTupleOut_t*)malloc(bytes);
+  if (ring == NULL)
+    return -1;
 
-    // detatch the original tail before returning
-    oldTail->prev = NULL;
+  memset(ring, 0, bytes);
+  free(ch->_ring);
+  ch->_ring = ring;
+  return 0;
+}
 
-    // link up the new tail correctly
-    ch->tail = newTail;
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: channelReadTuple -> connects to channel.read
+ * copies the next tuple into 'tuple' and increments read index.
+ * Must only be called from the channel's single consumer.
+ *
+ * NOTE: Returns -1 if the buffer is EMPTY.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+int channelReadTuple(channel_t* ch, mTupleOut_t* tuple)
+{
+  uint32_t tail = atomic_load_explicit(&ch->_tail, memory_order_relaxed);
 
-    // decrement channel counter because original tail was read
-    ch->count--;
-    return oldTail;
+  // only reload the writer's index when the cached copy says empty.
+  if (tail == ch->_cachedHead)
+  {
+    ch->_cachedHead = atomic_load_explicit(&ch->_head, memory_order_acquire);
+    if (tail == ch->_cachedHead)
+      return -1;
   }
-  else return NULL;
+
+  *tuple = ch->_ring[tail & ch->_mask];
+  atomic_store_explicit(&ch->_tail, tail + 1, memory_order_release);
+
+  // a slot was freed.. wake the writer if it is sleeping on a full ring.
+  _channelWake(ch, &ch->_writerWaiting, &ch->_notFull);
+  return 0;
 }
 
 /*
  * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
  * SUMMARY: channelWriteTuple -> conncets to channel.write
- * write the next tuple into the tuple list
+ * copies the tuple into the ring. Must only be called from the
+ * channel's single producer.
  *
  * NOTE: Returns -1 if the buffer is FULL.
  * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
  */
 int channelWriteTuple(channel_t* ch, mTupleOut_t* tuple)
 {
-  // only add to the FIFO if the buffer is not full.
-  if (ch->count < ch->max)
+  uint32_t head = atomic_load_explicit(&ch->_head, memory_order_relaxed);
+
+  // only reload the reader's index when the cached copy says full.
+  if (head - ch->_cachedTail >= (uint32_t)ch->max)
   {
+    ch->_cachedTail = atomic_load_explicit(&ch->_tail, memory_order_acquire);
+    if (head - ch->_cachedTail >= (uint32_t)ch->max)
+      return -1;
+  }
+
+  ch->_ring[head & ch->_mask] = *tuple;
+  atomic_store_explicit(&ch->_head, head + 1, memory_order_release);
+
+  // a tuple was published.. wake the reader if it is sleeping on an empty ring.
+  _channelWake(ch, &ch->_readerWaiting, &ch->_notEmpty);
+  if (ch->_bell != NULL)
+    _channelRingBell(ch->_bell);
+  return 0;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: channelReadTupleWait -> connects to channel.read_wait
+ * same as channelReadTuple, but sleeps while the ring is empty
+ * instead of returning.
+ *
+ * NOTE: Returns -1 once the channel is closed AND empty.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+int channelReadTupleWait(channel_t* ch, mTupleOut_t* tuple)
+{
+  while (channelReadTuple(ch, tuple) < 0)
+  {
+    if (_channelSleepReader(ch) < 0)
+      return -1;
+  }
+
+  return 0;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: channelWriteTupleWait -> connects to channel.write_wait
+ * same as channelWriteTuple, but sleeps while the ring is full
+ * instead of returning.
+ *
+ * NOTE: Returns -1 if the channel was closed.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+int channelWriteTupleWait(channel_t* ch, mTupleOut_t* tuple)
+{
+  while (channelWriteTuple(ch, tuple) < 0)
+  {
+    if (_channelSleepWriter(ch) < 0)
+      return -1;
+  }
 
-    // handle if this is the first tuple being written
-    if (ch->head == NULL || ch->tail == NULL)
+  return 0;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: channelReadBatch -> connects to channel.read_batch
+ * copies between 1 and 'max' tuples into 'tuples', sleeping while
+ * the ring is empty. Everything that is available (up to 'max') is
+ * taken in one go.
+ *
+ * NOTE: Returns the number of tuples read, or 0 once the channel
+ * is closed AND empty.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+int channelReadBatch(channel_t* ch, mTupleOut_t* tuples, int max)
+{
+  int n;
+
+  while ((n = _channelReadMany(ch, tuples, max)) == 0)
+  {
+    if (_channelSleepReader(ch) < 0)
+      return 0;
+  }
+
+  return n;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: channelTryReadBatch -> connects to channel.try_read_batch
+ * reads whatever is in the ring, up to 'max' tuples, without
+ * sleeping.
+ *
+ * NOTE: Returns the number of tuples read (0 if the ring is empty),
+ * or -1 once the channel is closed AND empty.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+int channelTryReadBatch(channel_t* ch, mTupleOut_t* tuples, int max)
+{
+  int n = _channelReadMany(ch, tuples, max);
+  if (n > 0 || !atomic_load(&ch->_closed))
+    return n;
+
+  // the writer may have published its last tuples right before closing
+  n = _channelReadMany(ch, tuples, max);
+  return (n > 0) ? n : -1;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: channelWriteBatch -> connects to channel.write_batch
+ * copies all 'n' tuples into the ring in order. As many tuples as
+ * fit are published at once; the writer only sleeps while the ring
+ * is completely full.
+ *
+ * NOTE: Returns -1 if the channel was closed before every tuple
+ * could be written.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+int channelWriteBatch(channel_t* ch, mTupleOut_t* tuples, int n)
+{
+  while (n > 0)
+  {
+    int written = _channelWriteMany(ch, tuples, n);
+    if (written == 0)
     {
-      tuple->next = NULL;
-      tuple->prev = NULL;
-      ch->head = tuple;
-      ch->tail = tuple;
+      if (_channelSleepWriter(ch) < 0)
+        return -1;
+      continue;
     }
 
-    // make the input tuple the new head and relink all nodes
-    else 
+    tuples += written;
+    n -= written;
+  }
+
+  return 0;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: channelClose -> connects to channel.close
+ * marks that no more tuples will be written (EOF) and wakes up
+ * any sleeping reader/writer. Tuples already in the ring can
+ * still be read.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+void channelClose(channel_t* ch)
+{
+  pthread_mutex_lock(&ch->_mutex);
+  atomic_store(&ch->_closed, 1);
+  pthread_cond_broadcast(&ch->_notEmpty);
+  pthread_cond_broadcast(&ch->_notFull);
+  pthread_mutex_unlock(&ch->_mutex);
+
+  if (ch->_bell != NULL)
+  {
+    pthread_mutex_lock(&ch->_bell->_mutex);
+    pthread_cond_broadcast(&ch->_bell->_ring);
+    pthread_mutex_unlock(&ch->_bell->_mutex);
+  }
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: channelCount
+ * returns the number of tuples currently in the ring. This is
+ * exact when called by either end while the other end is idle.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+int channelCount(channel_t* ch)
+{
+  uint32_t head = atomic_load_explicit(&ch->_head, memory_order_acquire);
+  uint32_t tail = atomic_load_explicit(&ch->_tail, memory_order_acquire);
+  return (int)(head - tail);
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: channelReady
+ * returns 1 if the ring has tuples, -1 if the channel is closed
+ * and empty, 0 if its reader has to keep waiting.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+int channelReady(channel_t* ch)
+{
+  return _channelAnyReady(&ch, 1);
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: channelBell
+ * initialize a bell that channels can be attached to with
+ * channelSetBell.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+int channelBell(channel_bell_t* bell)
+{
+  atomic_init(&bell->_waiting, 0);
+  pthread_mutex_init(&bell->_mutex, NULL);
+  pthread_cond_init(&bell->_ring, NULL);
+  return 0;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: channelBellDestruct
+ * destroy the bell. Channels attached to it must not be used
+ * afterwards.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+void channelBellDestruct(channel_bell_t* bell)
+{
+  pthread_mutex_destroy(&bell->_mutex);
+  pthread_cond_destroy(&bell->_ring);
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: channelSetBell
+ * attach the channel to a bell. Must be called before either end
+ * starts using the channel.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+void channelSetBell(channel_t* ch, channel_bell_t* bell)
+{
+  ch->_bell = bell;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: channelBellRing
+ * wakes every thread asleep on the bell. The caller publishes the
+ * state the sleepers wait for before ringing.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+void channelBellRing(channel_bell_t* bell)
+{
+  // pairs with the fence in channelBellWait.
+  atomic_thread_fence(memory_order_seq_cst);
+  _channelRingBell(bell);
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: channelBellWait
+ * sleeps on the bell until 'ready(arg)' returns non-zero. 'ready'
+ * is called with the bell's lock held, so it must not block.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+void channelBellWait(channel_bell_t* bell, int (*ready)(void* arg), void* arg)
+{
+  // same handshake as _channelSleepReader, on the bell instead.
+  pthread_mutex_lock(&bell->_mutex);
+  atomic_fetch_add(&bell->_waiting, 1);
+  atomic_thread_fence(memory_order_seq_cst);
+
+  while (!ready(arg))
+    pthread_cond_wait(&bell->_ring, &bell->_mutex);
+
+  atomic_fetch_sub(&bell->_waiting, 1);
+  pthread_mutex_unlock(&bell->_mutex);
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: channelReadAny
+ * reads 1..max tuples from whichever of the 'n' channels has some,
+ * sleeping on their shared bell while all of them are empty. The
+ * scan starts after the channel in '*which' so no channel is starved,
+ * and the channel that was read is stored back in '*which'.
+ *
+ * NOTE: Returns the number of tuples read, or 0 once every channel
+ * is closed AND empty.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+int channelReadAny(channel_t** chs, int n, int* which, mTupleOut_t* tuples, int max)
+{
+  channel_bell_t* bell = chs[0]->_bell;
+
+  while (1)
+  {
+    for (int i = 1; i <= n; i++)
     {
-      ch->head->prev = tuple;
-      ch->head = tuple;
+      int c = (*which + i) % n;
+      int numRead = _channelReadMany(chs[c], tuples, max);
+      if (numRead > 0)
+      {
+        *which = c;
+        return numRead;
+      }
     }
 
-    ch->count++;
-    return 0;
-  }
+    // same handshake as _channelSleepReader, on the bell instead.
+    pthread_mutex_lock(&bell->_mutex);
+    atomic_fetch_add(&bell->_waiting, 1);
+    atomic_thread_fence(memory_order_seq_cst);
 
-  // if the buffer is full, return an error
-  else return -1;
+    int ready;
+    while ((ready = _channelAnyReady(chs, n)) == 0)
+      pthread_cond_wait(&bell->_ring, &bell->_mutex);
+
+    atomic_fetch_sub(&bell->_waiting, 1);
+    pthread_mutex_unlock(&bell->_mutex);
+
+    if (ready < 0)
+      return 0;
+  }
 }
 
 /*
@@ -115,4 +501,200 @@ int channelSetUserId(channel_t* ch, char* userid)
 {
   strncpy((char*)ch->userid, userid, LEN_USER_ID*sizeof(char));
   return 0;
-}
\ No newline at end of file
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      PRIVATE FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: _channelWake
+ * signals 'cond' if the other side of the channel has raised its
+ * waiting flag. The lock is only taken when someone is asleep.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+static void _channelWake(channel_t* ch, atomic_int* waiting, pthread_cond_t* cond)
+{
+  // pairs with the fence in the *Wait functions.
+  atomic_thread_fence(memory_order_seq_cst);
+
+  if (atomic_load_explicit(waiting, memory_order_relaxed))
+  {
+    pthread_mutex_lock(&ch->_mutex);
+    pthread_cond_signal(cond);
+    pthread_mutex_unlock(&ch->_mutex);
+  }
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: _channelReadMany
+ * non-blocking read of up to 'n' tuples with a single tail update.
+ * Returns the number of tuples copied out (0 if empty).
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+static int _channelReadMany(channel_t* ch, mTupleOut_t* tuples, int n)
+{
+  uint32_t tail = atomic_load_explicit(&ch->_tail, memory_order_relaxed);
+  uint32_t avail = ch->_cachedHead - tail;
+
+  if (avail < (uint32_t)n)
+  {
+    ch->_cachedHead = atomic_load_explicit(&ch->_head, memory_order_acquire);
+    avail = ch->_cachedHead - tail;
+    if (avail == 0)
+      return 0;
+  }
+  if (avail > (uint32_t)n)
+    avail = n;
+
+  // copy out in at most two pieces when the batch wraps the ring.
+  uint32_t start = tail & ch->_mask;
+  uint32_t first = ch->_mask + 1 - start;
+  if (first > avail)
+    first = avail;
+  memcpy(tuples, &ch->_ring[start], first*sizeof(mTupleOut_t));
+  memcpy(tuples + first, &ch->_ring[0], (avail - first)*sizeof(mTupleOut_t));
+
+  atomic_store_explicit(&ch->_tail, tail + avail, memory_order_release);
+  _channelWake(ch, &ch->_writerWaiting, &ch->_notFull);
+  return (int)avail;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: _channelWriteMany
+ * non-blocking write of up to 'n' tuples with a single head update.
+ * Returns the number of tuples published (0 if full).
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+static int _channelWriteMany(channel_t* ch, mTupleOut_t* tuples, int n)
+{
+  uint32_t head = atomic_load_explicit(&ch->_head, memory_order_relaxed);
+  uint32_t space = (uint32_t)ch->max - (head - ch->_cachedTail);
+
+  if (space < (uint32_t)n)
+  {
+    ch->_cachedTail = atomic_load_explicit(&ch->_tail, memory_order_acquire);
+    space = (uint32_t)ch->max - (head - ch->_cachedTail);
+    if (space == 0)
+      return 0;
+  }
+  if (space > (uint32_t)n)
+    space = n;
+
+  uint32_t start = head & ch->_mask;
+  uint32_t first = ch->_mask + 1 - start;
+  if (first > space)
+    first = space;
+  memcpy(&ch->_ring[start], tuples, first*sizeof(mTupleOut_t));
+  memcpy(&ch->_ring[0], tuples + first, (space - first)*sizeof(mTupleOut_t));
+
+  atomic_store_explicit(&ch->_head, head + space, memory_order_release);
+  _channelWake(ch, &ch->_readerWaiting, &ch->_notEmpty);
+  if (ch->_bell != NULL)
+    _channelRingBell(ch->_bell);
+  return (int)space;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: _channelSleepReader
+ * puts the reader to sleep until the ring is not empty or the
+ * channel is closed.
+ *
+ * NOTE: Returns -1 if the channel is closed AND empty.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+static int _channelSleepReader(channel_t* ch)
+{
+  int drained = 0;
+
+  pthread_mutex_lock(&ch->_mutex);
+  atomic_store(&ch->_readerWaiting, 1);
+  atomic_thread_fence(memory_order_seq_cst);
+
+  // re-check after raising the flag.. a write that raced with the
+  // flag is either seen here or sees the flag and signals.
+  while (channelCount(ch) == 0 && !atomic_load(&ch->_closed))
+    pthread_cond_wait(&ch->_notEmpty, &ch->_mutex);
+
+  if (channelCount(ch) == 0)
+    drained = 1;
+
+  atomic_store(&ch->_readerWaiting, 0);
+  pthread_mutex_unlock(&ch->_mutex);
+
+  return drained ? -1 : 0;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: _channelSleepWriter
+ * puts the writer to sleep until the ring has a free slot or the
+ * channel is closed.
+ *
+ * NOTE: Returns -1 if the channel is closed.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+static int _channelSleepWriter(channel_t* ch)
+{
+  int closed = 0;
+
+  pthread_mutex_lock(&ch->_mutex);
+  atomic_store(&ch->_writerWaiting, 1);
+  atomic_thread_fence(memory_order_seq_cst);
+
+  while (channelCount(ch) >= ch->max && !atomic_load(&ch->_closed))
+    pthread_cond_wait(&ch->_notFull, &ch->_mutex);
+
+  closed = atomic_load(&ch->_closed);
+
+  atomic_store(&ch->_writerWaiting, 0);
+  pthread_mutex_unlock(&ch->_mutex);
+
+  return closed ? -1 : 0;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: _channelRingBell
+ * wakes the bell's sleepers, if any. Like _channelWake, the lock
+ * is only taken when someone is waiting.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+static void _channelRingBell(channel_bell_t* bell)
+{
+  // the fence in _channelWake already ordered the head store.
+  if (atomic_load_explicit(&bell->_waiting, memory_order_relaxed))
+  {
+    pthread_mutex_lock(&bell->_mutex);
+    pthread_cond_broadcast(&bell->_ring);
+    pthread_mutex_unlock(&bell->_mutex);
+  }
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: _channelAnyReady
+ * returns 1 if any channel has tuples, -1 if every channel is
+ * closed and empty, 0 if the reader has to keep waiting.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+static int _channelAnyReady(channel_t** chs, int n)
+{
+  int closed = 0;
+
+  for (int i = 0; i < n; i++)
+  {
+    if (channelCount(chs[i]) > 0)
+      return 1;
+    if (atomic_load(&chs[i]->_closed))
+      closed++;
+  }
+
+  return (closed == n) ? -1 : 0;
+}
@@ -6,6 +6,8 @@
 #include <string.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
 #include "mapper.h"
 
 /*
@@ -14,21 +16,59 @@
  * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
  */
 
-// channel structure is set up as a dynamic FIFO for tuples..
+// a bell lets readers sleep on several channels at once. Every
+// channel attached to the bell rings it when a tuple is published or
+// the channel is closed, and channelBellRing rings it for any other
+// event the sleepers wait for.
+typedef struct channelBell
+{
+  atomic_int _waiting;    // threads asleep on the bell
+  pthread_mutex_t _mutex;
+  pthread_cond_t _ring;
+} channel_bell_t;
+
+// channel structure is set up as a bounded single-producer/single-consumer
+// ring of tuples. Only the mapper thread writes to a channel and only its
+// reducer thread reads from it, so no lock is needed to move tuples. The
+// mutex/conditions are only used to put an idle side to sleep.
 typedef struct channelStruct
 {
   // public parameters
   char userid[LEN_USER_ID]; // user id for the selected channel
-  int max;                  // max number of tuples in the tuple array
-  int count;                // current number of tuples in FIFO
+  int max;                  // max number of tuples in the ring
 
-  mTupleOut_t* head; // ends of the linked list FIFO
-  mTupleOut_t* tail; // ends of the linked list FIFO
-  
   // functions
   int (*set_userid)(struct channelStruct* ch, char* userid); // sets the user id parameter
-  mTupleOut_t* (*read)(struct channelStruct* ch); // reads the next tuple and increments read pointer
-  int (*write)(struct channelStruct* ch, mTupleOut_t* tuple); // write the next tuple into the tuple array
+  int (*read)(struct channelStruct* ch, mTupleOut_t* tuple); // copies out the next tuple and increments read index
+  int (*write)(struct channelStruct* ch, mTupleOut_t* tuple); // copies the tuple into the ring
+  int (*read_wait)(struct channelStruct* ch, mTupleOut_t* tuple); // read, sleeping while the ring is empty
+  int (*write_wait)(struct channelStruct* ch, mTupleOut_t* tuple); // write, sleeping while the ring is full
+  int (*read_batch)(struct channelStruct* ch, mTupleOut_t* tuples, int max); // read 1..max tuples, sleeping while empty
+  int (*try_read_batch)(struct channelStruct* ch, mTupleOut_t* tuples, int max); // read 0..max tuples without sleeping
+  int (*write_batch)(struct channelStruct* ch, mTupleOut_t* tuples, int n); // write all n tuples, sleeping while full
+  void (*close)(struct channelStruct* ch); // no more writes.. wakes up the reader
+
+  // private parameters
+  mTupleOut_t* _ring; // tuples are stored inline, (_mask + 1) slots
+  uint32_t _mask;     // ring size is rounded up to a power of 2 for indexing
+
+  // producer side.. written by the mapper only. _cachedTail is the
+  // producer's last view of _tail so it rarely touches the reader's line.
+  _Alignas(CACHE_LINE_SIZE) atomic_uint _head;
+  uint32_t _cachedTail;
+
+  // consumer side.. written by the reducer only.
+  _Alignas(CACHE_LINE_SIZE) atomic_uint _tail;
+  uint32_t _cachedHead;
+
+  // sleep/wake state.. only touched when one side has to wait.
+  _Alignas(CACHE_LINE_SIZE) atomic_int _readerWaiting;
+  atomic_int _writerWaiting;
+  atomic_int _closed;
+  pthread_mutex_t _mutex;
+  pthread_cond_t _notEmpty;
+  pthread_cond_t _notFull;
+  channel_bell_t* _bell;  // optional.. shared with the reader's other channels
 
 } channel_t;
 
@@ -39,8 +79,24 @@ typedef struct channelStruct
  */
 
 int channel(channel_t* ch, int size);
+void channelDestruct(channel_t* ch);
+int channelPlace(channel_t* ch);
 int channelSetUserId(channel_t* ch, char* userid);
-mTupleOut_t* channelReadTuple(channel_t* ch);
-int channelWriteTuple(channel_t* ch, mTupleOut_t*);
+int channelReadTuple(channel_t* ch, mTupleOut_t* tuple);
+int channelWriteTuple(channel_t* ch, mTupleOut_t* tuple);
+int channelReadTupleWait(channel_t* ch, mTupleOut_t* tuple);
+int channelWriteTupleWait(channel_t* ch, mTupleOut_t* tuple);
+int channelReadBatch(channel_t* ch, mTupleOut_t* tuples, int max);
+int channelTryReadBatch(channel_t* ch, mTupleOut_t* tuples, int max);
+int channelWriteBatch(channel_t* ch, mTupleOut_t* tuples, int n);
+void channelClose(channel_t* ch);
+int channelCount(channel_t* ch);
+int channelReady(channel_t* ch);
+int channelBell(channel_bell_t* bell);
+void channelBellDestruct(channel_bell_t* bell);
+void channelSetBell(channel_t* ch, channel_bell_t* bell);
+void channelBellRing(channel_bell_t* bell);
+void channelBellWait(channel_bell_t* bell, int (*ready)(void* arg), void* arg);
+int channelReadAny(channel_t** chs, int n, int* which, mTupleOut_t* tuples, int max);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,383 @@
+/*
+ * SUMMARY: channelBench.c
+ * Throughput comparison between the SPSC ring channel and the original
+ * channel (malloc'd linked list FIFO guarded by one global mutex that
+ * every channel shares). One producer thread spreads tuples round-robin
+ * over the channels and one consumer thread drains each channel, which
+ * is how the combiner uses them.
+ *
+ * VARIANTS:
+ * mutex-list - original channel, retries with sched_yield()
+ * spsc-spin  - ring, retries with sched_yield()
+ * spsc-poll  - ring, retries with usleep(50) like the old combiner threads
+ * spsc-block - ring, sleeps in read_wait/write_wait until notified
+ * spsc-batch - ring, like spsc-block but moves BENCH_BATCH_SIZE tuples
+ *              per write_batch/read_batch call
+ *
+ * Tuples/s and the process CPU time (user + sys) are reported for each.
+ *
+ * USAGE: ./channelBench [numTuples] [bufSize]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+#include "channel.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           DEFINES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+#define DEFAULT_NUM_TUPLES  2000000
+#define DEFAULT_BUF_SIZE    64
+#define BENCH_BATCH_SIZE    32
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           TYPEDEFS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+// Linked list FIFO equivalent to the original channel_t.
+typedef struct listTuple
+{
+  mTupleOut_t tuple;
+  struct listTuple* next;
+} list_tuple_t;
+
+typedef struct listChannel
+{
+  int max;
+  int count;
+  list_tuple_t* head;
+  list_tuple_t* tail;
+} list_channel_t;
+
+typedef enum variant
+{
+  E_MUTEX_LIST,
+  E_SPSC_SPIN,
+  E_SPSC_POLL,
+  E_SPSC_BLOCK,
+  E_SPSC_BATCH,
+  NUM_VARIANTS
+} variant_t;
+
+typedef struct benchArgs
+{
+  variant_t variant;
+  int numChannels;
+  int channelNum;
+  long numTuples;     // tuples written in total (producer) or expected (consumer)
+  int64_t checksum;   // sum of weights read by a consumer
+} bench_args_t;
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           GLOBALS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+static const char* VARIANT_NAME[NUM_VARIANTS] = {"mutex-list", "spsc-spin", "spsc-poll", "spsc-block", "spsc-batch"};
+
+static pthread_mutex_t mutexList = PTHREAD_MUTEX_INITIALIZER;
+static list_channel_t* listArray;
+static channel_t* ringArray;
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                       LINKED LIST CHANNEL
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+static int listWrite(list_channel_t* ch, mTupleOut_t* tuple)
+{
+  list_tuple_t* node = malloc(sizeof(list_tuple_t));
+  node->tuple = *tuple;
+  node->next = NULL;
+
+  pthread_mutex_lock(&mutexList);
+  if (ch->count == ch->max)
+  {
+    pthread_mutex_unlock(&mutexList);
+    free(node);
+    return -1;
+  }
+
+  if (ch->tail == NULL)
+    ch->head = node;
+  else
+    ch->tail->next = node;
+  ch->tail = node;
+  ch->count++;
+  pthread_mutex_unlock(&mutexList);
+  return 0;
+}
+
+static int listRead(list_channel_t* ch, mTupleOut_t* tuple)
+{
+  pthread_mutex_lock(&mutexList);
+  list_tuple_t* node = ch->head;
+  if (node == NULL)
+  {
+    pthread_mutex_unlock(&mutexList);
+    return -1;
+  }
+
+  ch->head = node->next;
+  if (ch->head == NULL)
+    ch->tail = NULL;
+  ch->count--;
+  pthread_mutex_unlock(&mutexList);
+
+  *tuple = node->tuple;
+  free(node);
+  return 0;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           THREADS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+static void* producer(void* argsAddr)
+{
+  bench_args_t* args = (bench_args_t*)argsAddr;
+  mTupleOut_t tuple;
+
+  memset(&tuple, 0, sizeof(tuple));
+  memcpy(tuple.topic, "history        ", LEN_TOPIC);
+
+  // per-channel batches for the batch variant
+  mTupleOut_t* pending = malloc(args->numChannels*BENCH_BATCH_SIZE*sizeof(mTupleOut_t));
+  int* pendingCount = calloc(args->numChannels, sizeof(int));
+
+  for (long i = 0; i < args->numTuples; i++)
+  {
+    int ch = i % args->numChannels;
+    tuple.weight = RULE_WEIGHT[i % MAPPING_COUNT];
+
+    switch (args->variant)
+    {
+      case E_MUTEX_LIST:
+        while (listWrite(&listArray[ch], &tuple) < 0)
+          sched_yield();
+        break;
+
+      case E_SPSC_SPIN:
+        while (ringArray[ch].write(&ringArray[ch], &tuple) < 0)
+          sched_yield();
+        break;
+
+      case E_SPSC_POLL:
+        while (ringArray[ch].write(&ringArray[ch], &tuple) < 0)
+          usleep(50);
+        break;
+
+      case E_SPSC_BLOCK:
+        ringArray[ch].write_wait(&ringArray[ch], &tuple);
+        break;
+
+      default:
+        pending[ch*BENCH_BATCH_SIZE + pendingCount[ch]++] = tuple;
+        if (pendingCount[ch] == BENCH_BATCH_SIZE)
+        {
+          ringArray[ch].write_batch(&ringArray[ch], &pending[ch*BENCH_BATCH_SIZE], BENCH_BATCH_SIZE);
+          pendingCount[ch] = 0;
+        }
+        break;
+    }
+  }
+
+  for (int i = 0; i < args->numChannels; i++)
+  {
+    if (pendingCount[i] > 0)
+      ringArray[i].write_batch(&ringArray[i], &pending[i*BENCH_BATCH_SIZE], pendingCount[i]);
+  }
+  free(pending);
+  free(pendingCount);
+
+  // EOF for the blocking readers
+  for (int i = 0; i < args->numChannels; i++)
+    ringArray[i].close(&ringArray[i]);
+
+  return NULL;
+}
+
+static void* consumer(void* argsAddr)
+{
+  bench_args_t* args = (bench_args_t*)argsAddr;
+  mTupleOut_t tuple;
+
+  channel_t* ch = &ringArray[args->channelNum];
+
+  if (args->variant == E_SPSC_BATCH)
+  {
+    mTupleOut_t batch[BENCH_BATCH_SIZE];
+    int n;
+    while ((n = ch->read_batch(ch, batch, BENCH_BATCH_SIZE)) > 0)
+    {
+      for (int i = 0; i < n; i++)
+        args->checksum += batch[i].weight;
+    }
+    return NULL;
+  }
+
+  for (long i = 0; i < args->numTuples; i++)
+  {
+    switch (args->variant)
+    {
+      case E_MUTEX_LIST:
+        while (listRead(&listArray[args->channelNum], &tuple) < 0)
+          sched_yield();
+        break;
+
+      case E_SPSC_SPIN:
+        while (ch->read(ch, &tuple) < 0)
+          sched_yield();
+        break;
+
+      case E_SPSC_POLL:
+        while (ch->read(ch, &tuple) < 0)
+          usleep(50);
+        break;
+
+      case E_SPSC_BLOCK:
+        if (ch->read_wait(ch, &tuple) < 0)
+          return NULL;
+        break;
+
+      default:
+        break;
+    }
+    args->checksum += tuple.weight;
+  }
+
+  return NULL;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: runBench
+ * Pushes numTuples through numChannels channels of the selected
+ * variant and returns the tuples/s achieved. The CPU seconds used
+ * by the run are stored in cpuSeconds.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static double runBench(variant_t variant, int numChannels, long numTuples, int bufSize, double* cpuSeconds)
+{
+  pthread_t pthread;
+  pthread_t* cthread = malloc(numChannels*sizeof(pthread_t));
+  bench_args_t pargs;
+  bench_args_t* cargs = malloc(numChannels*sizeof(bench_args_t));
+  struct timespec start, end;
+  struct rusage usageStart, usageEnd;
+
+  // round the tuple count so every channel gets the same share
+  numTuples -= numTuples % numChannels;
+
+  listArray = calloc(numChannels, sizeof(list_channel_t));
+  posix_memalign((void**)&ringArray, CACHE_LINE_SIZE, numChannels*sizeof(channel_t));
+  for (int i = 0; i < numChannels; i++)
+  {
+    listArray[i].max = bufSize;
+    channel(&ringArray[i], bufSize);
+  }
+
+  getrusage(RUSAGE_SELF, &usageStart);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  for (int i = 0; i < numChannels; i++)
+  {
+    cargs[i].variant = variant;
+    cargs[i].numChannels = numChannels;
+    cargs[i].channelNum = i;
+    cargs[i].numTuples = numTuples / numChannels;
+    cargs[i].checksum = 0;
+    pthread_create(&cthread[i], NULL, consumer, &cargs[i]);
+  }
+
+  pargs.variant = variant;
+  pargs.numChannels = numChannels;
+  pargs.numTuples = numTuples;
+  pthread_create(&pthread, NULL, producer, &pargs);
+
+  pthread_join(pthread, NULL);
+  for (int i = 0; i < numChannels; i++)
+    pthread_join(cthread[i], NULL);
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  getrusage(RUSAGE_SELF, &usageEnd);
+  double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  *cpuSeconds = (usageEnd.ru_utime.tv_sec - usageStart.ru_utime.tv_sec)
+              + (usageEnd.ru_utime.tv_usec - usageStart.ru_utime.tv_usec) / 1e6
+              + (usageEnd.ru_stime.tv_sec - usageStart.ru_stime.tv_sec)
+              + (usageEnd.ru_stime.tv_usec - usageStart.ru_stime.tv_usec) / 1e6;
+
+  // every weight should have made it through exactly once
+  int64_t checksum = 0, expected = 0;
+  for (int i = 0; i < numChannels; i++)
+    checksum += cargs[i].checksum;
+  for (long i = 0; i < numTuples; i++)
+    expected += RULE_WEIGHT[i % MAPPING_COUNT];
+  if (checksum != expected)
+    printf("ERROR: checksum mismatch (%lld != %lld)\n", (long long)checksum, (long long)expected);
+
+  for (int i = 0; i < numChannels; i++)
+    channelDestruct(&ringArray[i]);
+  free(ringArray);
+  free(listArray);
+  free(cargs);
+  free(cthread);
+
+  return numTuples / seconds;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                              MAIN
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+int main(int argc, char **argv)
+{
+  long numTuples = (argc > 1) ? atol(argv[1]) : DEFAULT_NUM_TUPLES;
+  int bufSize = (argc > 2) ? atoi(argv[2]) : DEFAULT_BUF_SIZE;
+  const int reducers[] = {1, 4, 16};
+
+  if (numTuples <= 0 || bufSize <= 0)
+  {
+    printf("ERROR: Expecting ./channelBench [numTuples] [bufSize]\n");
+    return -1;
+  }
+
+  printf("tuples=%ld bufSize=%d\n", numTuples, bufSize);
+  printf("%-9s %-11s %14s %10s\n", "reducers", "variant", "tuples/s", "cpu(s)");
+
+  for (int i = 0; i < (int)(sizeof(reducers)/sizeof(reducers[0])); i++)
+  {
+    for (int v = 0; v < NUM_VARIANTS; v++)
+    {
+      double cpuSeconds;
+      double rate = runBench((variant_t)v, reducers[i], numTuples, bufSize, &cpuSeconds);
+      printf("%-9d %-11s %14.0f %10.3f\n", reducers[i], VARIANT_NAME[v], rate, cpuSeconds);
+    }
+  }
+
+  return 0;
+}
@@ -1,315 +1,1073 @@
-#include <stdint.h>
-#include <stdio.h>
-#include <string.h>
-#include <unistd.h>
-#include <sys/wait.h>
-#include <stdlib.h>
-#include <pthread.h>
-
-#include "common.h"
-#include "mapper.h"
-#include "reducer.h"
-#include "channel.h"
-
-/*
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
- *                      DEFINES
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
- */
-
-#define COMBINER_DEBUG_MODE 0
-#define PIPE_SIZE           100
-#define STDIN_FD            0
-#define STDOUT_FD           1
-#define NUM_CHILDREN        2
-
-/*
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
- *                      PROTOTYPES
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
- */
-
-void* mapper(void* dummy);
-void* reducer(void* channelNumAddr);
-
-/*
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
- *                       GLOBALS
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
- */
- 
- pthread_mutex_t mutexFifo = PTHREAD_MUTEX_INITIALIZER;
- pthread_mutex_t mutexStdout = PTHREAD_MUTEX_INITIALIZER;
- pthread_mutex_t mutexFlag = PTHREAD_MUTEX_INITIALIZER;
-
- volatile uint8_t flagMapperComplete;
- volatile channel_t * chArray;
-
- pthread_t mthread;
- pthread_t* rthread;
- int bufSize;
- int numRThreads;
-
-/*
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
- *                    MAIN / PROCESSES
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
- */
-
-int main(int argc, char **argv)
-{
-  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
-  // turn off stdout/stdin buffers
-  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
-  setbuf(stdout, NULL);
-  setbuf(stdin, NULL);
-
-  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
-  // handle command line arguments
-  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
-  bufSize = atoi(argv[1]);
-  numRThreads = atoi(argv[2]);
-
-  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
-  // initialize local + global variables
-  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
-  flagMapperComplete = 0; // flag for mapper to notify reducer of completion
-  rthread = (pthread_t*)malloc(numRThreads*sizeof(pthread_t));
-
-  // initialize channels+buffers for passing tuples to reducers
-  chArray = (channel_t*)malloc(numRThreads*sizeof(channel_t));
-
-  for (int i = 0; i < numRThreads; i++)
-  {
-    if (channel((channel_t*)&chArray[i], bufSize) == -1)
-      return 0;
-  }
-
-  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
-  // start all threads..
-  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
-
-  // mallocating channel ID so that the thread can initialize before
-  // the for loop number changes
-  int * channelId = malloc(numRThreads*sizeof(int));
-
-  pthread_create(&mthread, NULL, mapper, NULL);
-  for (int i = 0; i < numRThreads; i++)
-  {
-    channelId[i] = i;
-    pthread_create(&rthread[i], NULL, reducer, (void*)&channelId[i]);
-  }
-  
-  // Wait for threads to exit.. Mapper waits for all reducers,
-  // so main only needs to wait for the mapper thread.
-  pthread_join(mthread, NULL);
-
-  debugger("MAIN - Exitting..", COMBINER_DEBUG_MODE);
-  
-  // after all channel buffers have been read by reducer threads,
-  // channels may be deallocated.
-  free(rthread);
-  free(channelId);
-  free((void*)chArray);
-  return 0;
-}
-
-/*
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
- *                       THREADS
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
- */
-
-/*
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
- * SUMMARY: mapper
- * This function maps an input tuple into a different tuple
- * using the rules defined below. The generated tuple is immediately
- * output to the terminal.
- * 
- * RULES:
- * P = 50, L = 20, D = -10, C = 30, S = 40
- * 
- * EXAMPlE INPUT:   (1111,P,history)
- * EXAMPLE OUTPUT:  (1111,history,50)
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
- */
-void* mapper(void* dummy)
-{
-  debugger("Starting MAPPER..", COMBINER_DEBUG_MODE);
-
-  int maxChannelNum = -1;
-  int writeErr = 0;
-  channel_t * ch;
-
-  while (1)
-  {
-    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
-    // ** GET NEW TUPLE VALUE **
-    // Get data from the std input and check that it is a valid tuple.
-    // If valid, continue with the program.
-    // If not valid, set flag to notify reducer threads and exit the program.
-    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
-    mTupleIn_t* inputTuple = m_console_tuple_read();
-    if (inputTuple == NULL)
-    {
-      break; // EOF found
-    }
-
-    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
-    // ** CHOOSE WHICH CHANNEL TO WRITE TUPLE TO **
-    // Check if the current tuple's user id matches any mapper channels
-    // If yes, write to that channel.
-    // If not, create a new channel with the current userid.
-    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
-    for (int i = 0; i < numRThreads; i++)
-    {
-      // ** This statement will be true if the currently selected channel's userid
-      //    matches with the current input tuple.
-      ch = (channel_t*)&chArray[i];
-
-      if (strncmp(inputTuple->userid, 
-                  ch->userid, 
-                  LEN_USER_ID*sizeof(char)) == 0)
-      {
-        break;
-      }
-
-      // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
-      // ** If the currently selected channel is greater than the channel count, 
-      //    make a new channel, store the tuple values to it, and increase the channel
-      //    count.
-      // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
-      if (i > maxChannelNum)
-      {
-        maxChannelNum = i;
-        ch->set_userid(ch, inputTuple->userid);
-        break;
-      }
-    }
-
-    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
-    // ** MAPPING DATA AND STORING TO CHANNEL QUEUE **
-    // map the data to the output tuple and output
-    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
-    mTupleOut_t* outTuple = map(inputTuple);
-
-    // try to write to the FIFO until the write is successfull
-    do
-    {
-      usleep(50);
-      pthread_mutex_lock(&mutexFifo);
-      writeErr = ch->write(ch, outTuple);
-      pthread_mutex_unlock(&mutexFifo);
-    } while(writeErr < 0);
-  }  
-
-  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
-  // ** FREE ALL MEMORY ALLOCATED DATA **
-  // Signal the reducer threads that the mapper thread is complete.
-  // Wait for all reducer threads to complete, then deallocate the buffer of tuples.
-  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
-  pthread_mutex_lock(&mutexFlag);
-  flagMapperComplete = 1;
-  pthread_mutex_unlock(&mutexFlag);
-  
-  for (int i = 0; i < numRThreads; i++)
-    pthread_join(rthread[i], NULL);
-
-  return NULL;
-}
-
-/*
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
- * SUMMARY: reducer
- * This process runs the reducer program and routes the 
- * standard input to pipe.
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
- */
-void* reducer(void* channelNumAddr)
-{
-  debugger("Starting REDUCER..", COMBINER_DEBUG_MODE);
-
-  int channelNum = *(int*)channelNumAddr;
-  channel_t* ch = (channel_t*)&chArray[channelNum];
-  rTupleIn_t* tuple = NULL;
-  node_t * dictionary = NULL;
-
-  // initialize the user ID
-  char currId[LEN_USER_ID];
-  char prevId[LEN_USER_ID];
-  for (uint16_t i = 0; i < LEN_USER_ID; i++)
-  {
-    currId[i] = 'X';
-    prevId[i] = 'Y';
-  }
-
-  //while(flagMapperComplete == 0 || ch->count > 0)
-  while(1)
-  {
-    int exit = 0;
-
-    // break out of the while loop if the mapper is complete AND
-    // the channel is empty
-    pthread_mutex_lock(&mutexFlag);
-    if (flagMapperComplete) exit++;
-    pthread_mutex_unlock(&mutexFlag);
-
-    pthread_mutex_lock(&mutexFifo);
-    if (ch->count == 0) exit++;
-    pthread_mutex_unlock(&mutexFifo);
-
-    if (exit == 2) break;
-
-    // read in tuples from the channel FIFOs
-    usleep(50);
-    pthread_mutex_lock(&mutexFifo);
-    tuple = (rTupleIn_t*)ch->read(ch); 
-    pthread_mutex_unlock(&mutexFifo);
-
-    // no error in tuple format and has not reached end of the file
-    if (tuple != NULL)
-    {
-      // update the current user id and check if it's still
-      // equal to the previous user id.
-      copyUserId(currId, tuple->userid);
-
-      // check if this is a new id.. if yes, clear out the dictionary 
-      // and reinitialize the data structure
-      if (compareUserId(currId, prevId) == -1)
-      {
-        // display all contents of the hash map as a list of tuples
-        r_console_tuple_write(prevId, dictionary);
-
-        // deallocate heap memory for hash map
-        dictFreeNodes(dictionary);
-
-        // initialize a new hash map
-        dictionary = dict();
-      }
-
-      // store the new tuple value in the hash map
-      reduce(dictionary, tuple);
-      free(tuple);
-    }
-
-    // update the previous user id with the new user id
-    copyUserId(prevId, currId);
-
-#if REDUCER_DEBUG_MODE == 1
-    // display the contents of the dictionary to see if elements are being
-    // added correctly.
-    dictDisplayContents(dictionary);
-#endif
-  }
-
-  // final check to make sure dictionary was deallocated before exit
-  pthread_mutex_lock(&mutexStdout);
-  r_console_tuple_write(currId, dictionary);
-  pthread_mutex_unlock(&mutexStdout);
-
-  dictFreeNodes(dictionary);
-
-  debugger("Reducer exitting..", REDUCER_DEBUG_MODE);
-  return NULL;
-}
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include <getopt.h>
+#include <fcntl.h>
+
+#include "common.h"
+#include "mapper.h"
+#include "reducer.h"
+#include "channel.h"
+#include "router.h"
+#include "parser.h"
+#include "merge.h"
+#include "aggregate.h"
+#include "spill.h"
+#include "xsort.h"
+#include "steal.h"
+#include "affinity.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      DEFINES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+#define COMBINER_DEBUG_MODE 0
+#define PIPE_SIZE           100
+#define STDIN_FD            0
+#define STDOUT_FD           1
+#define NUM_CHILDREN        2
+#define MAPPER_BATCH_SIZE   64    // max tuples buffered per channel before a flush
+#define MAPPER_FLUSH_USEC   1000  // max age of a buffered tuple before a flush
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+void* mapper(void* mapperNumAddr);
+void* reducer(void* channelNumAddr);
+static void* reducerMerge(int channelNum);
+static void* reducerSpill(int channelNum);
+static void* reducerSteal(int channelNum);
+static int stealQueue(steal_t* s, int worker, mTupleOut_t* tuples, int n);
+static int stealWaitReady(void* arg);
+static uint64_t nowUsec();
+static int flushBatch(int chIndex);
+static void batchTuples(int mapperNum, mTupleOut_t* tuples, int n, uint64_t now);
+static void sendTuple(int mapperNum, mTupleOut_t* tuple, uint64_t now, uint64_t* lastAgeCheck);
+static void sendPartials(int mapperNum, uint64_t now);
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                       GLOBALS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+ 
+ pthread_mutex_t mutexStdout = PTHREAD_MUTEX_INITIALIZER;
+
+ // numMappers x numRThreads channels. Mapper m writes to reducer r
+ // through chArray[m*numRThreads + r], so every channel is still SPSC.
+ volatile channel_t * chArray;
+
+ pthread_t* mthread;
+ pthread_t* rthread;
+ int bufSize;
+ int numRThreads;
+ int numMappers = 1;
+
+ // one router and one parser per mapper thread
+ router_t* rtArray;
+ parser_t* inputArray;
+
+ // shard mode.. each mapper parses its own byte range of the input file
+ // and each reducer waits on its numMappers channels through one bell.
+ char* inputPath;
+ channel_bell_t* bellArray;
+
+ // mapper side pre-aggregation (-c), one table per mapper thread
+ aggregate_t* aggArray;
+
+ // unsorted input mode (-u).. one spilling user table per reducer thread
+ spill_t* spillArray;
+
+ // external sort stage (-x) between the mapper and the reducers
+ xsort_t* sortArray;
+
+ // work stealing scheduler shared by the reducer threads (-W)
+ steal_t* scheduler;
+
+ // CPU list of -a.. mappers take the first slots, the reducers the next.
+ // 'placed' holds the mappers back until every reducer has moved its
+ // rings and output buffer to its own NUMA node.
+ affinity_t cpuMap;
+ pthread_barrier_t placed;
+
+ // one result writer per reducer thread
+ output_t* outArray;
+ int orderedOutput;
+
+ // mapper side batches, one per channel. Only touched by the channel's mapper.
+ mTupleOut_t* batch;
+ int* batchCount;
+ uint64_t* batchStart;
+ int batchSize;
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                    MAIN / PROCESSES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+int main(int argc, char **argv)
+{
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  // turn off stdout buffer for error messages. Results go through the
+  // output writers and stdin is read in bulk by the parser.
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  setbuf(stdout, NULL);
+
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  // handle command line arguments
+  // ./combiner [-p sticky|hash|least] [-o] [-s] [-c] [-u | -x [-t sortThreads]] [-W] [-M mb] [-f file [-m numMappers]] [-w rules] [-a cpuList] bufSize numRThreads
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  int policy = -2; // -2 until -p is given, -1 for an unknown policy
+  int showStats = 0;
+  int preAggregate = 0;
+  int unsortedInput = 0;
+  int sortInput = 0;
+  int stealWork = 0;
+  int sortThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  int budgetMb = SPILL_DEFAULT_MB;
+  char* cpuList = NULL;
+  int opt;
+
+  // shard mode defaults to one mapper per CPU
+  numMappers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+  rulesDefault();
+  while ((opt = getopt(argc, argv, "p:oscuxt:WM:f:m:w:a:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'p':
+        policy = routerParsePolicy(optarg);
+        break;
+      case 'f':
+        inputPath = optarg;
+        break;
+      case 'm':
+        numMappers = atoi(optarg);
+        break;
+      case 'o':
+        orderedOutput = 1;
+        break;
+      case 's':
+        showStats = 1;
+        break;
+      case 'c':
+        preAggregate = 1;
+        break;
+      case 'u':
+        unsortedInput = 1;
+        break;
+      case 'x':
+        sortInput = 1;
+        break;
+      case 't':
+        sortThreads = atoi(optarg);
+        break;
+      case 'W':
+        stealWork = 1;
+        break;
+      case 'M':
+        budgetMb = atoi(optarg);
+        break;
+      case 'w':
+        if (rulesLoad(optarg) == -1)
+          return -1;
+        break;
+      case 'a':
+        cpuList = optarg;
+        break;
+      default:
+        policy = -1;
+        break;
+    }
+  }
+
+  if (policy == -1 || argc - optind < 2)
+  {
+    printf("ERROR: Expecting ./combiner [-p sticky|hash|least] [-o] [-s] [-c] [-u | -x [-t sortThreads]] [-W] [-M mb] [-f file [-m numMappers]] [-w rules] [-a cpuList] bufSize numRThreads\n");
+    return -1;
+  }
+
+  bufSize = atoi(argv[optind]);
+  numRThreads = atoi(argv[optind + 1]);
+  if (bufSize <= 0 || numRThreads <= 0 || numMappers <= 0 || budgetMb <= 0 || sortThreads <= 0)
+  {
+    printf("ERROR: bufSize, numRThreads, numMappers, sortThreads and the -M budget must be positive.\n");
+    return -1;
+  }
+
+  if (affinity(&cpuMap, cpuList) == -1)
+  {
+    printf("ERROR: -a expects a list of available CPUs like 0-3,8.\n");
+    return -1;
+  }
+
+  // shard mode already merges each reducer's users at the end, and
+  // -u and -x are two ways of handling the same (unsorted) input
+  if ((inputPath != NULL && (unsortedInput || sortInput)) || (unsortedInput && sortInput))
+  {
+    printf("ERROR: -u, -x and -f can't be combined.\n");
+    return -1;
+  }
+
+  // the spilling and shard reducers keep their own per-user state
+  if (stealWork && (inputPath != NULL || unsortedInput))
+  {
+    printf("ERROR: -W can't be combined with -u or -f.\n");
+    return -1;
+  }
+
+  // every mapper must send a user to the same reducer, which only the
+  // stateless hash policy guarantees.
+  if (inputPath != NULL)
+  {
+    if (policy >= 0 && policy != E_ROUTE_HASH)
+    {
+      printf("ERROR: -f can only be used with -p hash.\n");
+      return -1;
+    }
+    policy = E_ROUTE_HASH;
+  }
+  else
+  {
+    numMappers = 1;
+    if (policy < 0)
+      policy = E_ROUTE_STICKY;
+  }
+  int numChannels = numMappers*numRThreads;
+
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  // initialize local + global variables
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  rthread = (pthread_t*)malloc(numRThreads*sizeof(pthread_t));
+  mthread = (pthread_t*)malloc(numMappers*sizeof(pthread_t));
+
+  // a batch never needs to be bigger than the ring it is flushed into
+  batchSize = (bufSize < MAPPER_BATCH_SIZE) ? bufSize : MAPPER_BATCH_SIZE;
+  batch = (mTupleOut_t*)malloc(numChannels*batchSize*sizeof(mTupleOut_t));
+  batchCount = (int*)calloc(numChannels, sizeof(int));
+  batchStart = (uint64_t*)calloc(numChannels, sizeof(uint64_t));
+  if (batch == NULL || batchCount == NULL || batchStart == NULL)
+    return 0;
+
+  // result writers. Unordered writers flush a full buffer at a time under
+  // mutexStdout; ordered (held) writers are emitted in channel order by
+  // main once every reducer is done.
+  if (posix_memalign((void**)&outArray, CACHE_LINE_SIZE, numRThreads*sizeof(output_t)) != 0)
+    return 0;
+  for (int i = 0; i < numRThreads; i++)
+  {
+    if (output(&outArray[i], STDOUT_FD, orderedOutput, orderedOutput ? NULL : &mutexStdout) == -1)
+      return 0;
+  }
+
+  // block reader for each mapper thread.. the std input, or one
+  // tuple aligned byte range of the input file per mapper.
+  inputArray = (parser_t*)malloc(numMappers*sizeof(parser_t));
+  if (inputArray == NULL)
+    return 0;
+
+  int inputFd = STDIN_FD;
+  if (inputPath == NULL)
+  {
+    if (parser(&inputArray[0], STDIN_FD) == -1)
+      return 0;
+  }
+  else
+  {
+    off_t* bounds = (off_t*)malloc((numMappers + 1)*sizeof(off_t));
+    if (bounds == NULL)
+      return 0;
+
+    if ((inputFd = open(inputPath, O_RDONLY)) == -1 || parserSplit(inputFd, numMappers, bounds) == -1)
+    {
+      printf("ERROR: Could not read %s.\n", inputPath);
+      return -1;
+    }
+
+    for (int i = 0; i < numMappers; i++)
+    {
+      if (parserRange(&inputArray[i], inputFd, bounds[i], bounds[i + 1]) == -1)
+        return 0;
+    }
+    free(bounds);
+  }
+
+  // pre-aggregation tables, one per mapper
+  if (preAggregate)
+  {
+    aggArray = (aggregate_t*)malloc(numMappers*sizeof(aggregate_t));
+    if (aggArray == NULL)
+      return 0;
+    for (int i = 0; i < numMappers; i++)
+      aggregate(&aggArray[i]);
+  }
+
+  // per reducer user tables for unsorted input. Every policy keeps a
+  // user on one reducer, so the budget is simply split between them.
+  if (unsortedInput)
+  {
+    spillArray = (spill_t*)malloc(numRThreads*sizeof(spill_t));
+    if (spillArray == NULL)
+      return 0;
+    for (int i = 0; i < numRThreads; i++)
+    {
+      if (spill(&spillArray[i], ((size_t)budgetMb << 20) / numRThreads) == -1)
+        return 0;
+    }
+  }
+
+  // external sort in front of the reducers.. the single mapper owns it
+  if (sortInput)
+  {
+    sortArray = (xsort_t*)malloc(sizeof(xsort_t));
+    if (sortArray == NULL || xsort(sortArray, (size_t)budgetMb << 20, sortThreads) == -1)
+      return 0;
+  }
+
+  // user id -> channel routing table used by each mapper thread
+  rtArray = (router_t*)malloc(numMappers*sizeof(router_t));
+  if (rtArray == NULL)
+    return 0;
+  for (int i = 0; i < numMappers; i++)
+  {
+    if (router(&rtArray[i], numRThreads, (route_policy_t)policy) == -1)
+      return 0;
+  }
+
+  // initialize channels+buffers for passing tuples to reducers. Channels
+  // are cache line aligned so neighbouring rings don't share index lines.
+  if (posix_memalign((void**)&chArray, CACHE_LINE_SIZE, numChannels*sizeof(channel_t)) != 0)
+    return 0;
+
+  for (int i = 0; i < numChannels; i++)
+  {
+    if (channel((channel_t*)&chArray[i], bufSize) == -1)
+      return 0;
+  }
+
+  // with -W the reducers share their work. Every channel rings the
+  // scheduler's bell, so an idle reducer sleeps on that bell alone.
+  if (stealWork)
+  {
+    scheduler = (steal_t*)malloc(sizeof(steal_t));
+    if (scheduler == NULL || steal(scheduler, numRThreads) == -1)
+      return 0;
+    for (int i = 0; i < numChannels; i++)
+      channelSetBell((channel_t*)&chArray[i], &scheduler->bell);
+  }
+
+  // in shard mode a reducer reads from one channel per mapper
+  if (inputPath != NULL)
+  {
+    bellArray = (channel_bell_t*)malloc(numRThreads*sizeof(channel_bell_t));
+    if (bellArray == NULL)
+      return 0;
+
+    for (int r = 0; r < numRThreads; r++)
+    {
+      channelBell(&bellArray[r]);
+      for (int m = 0; m < numMappers; m++)
+        channelSetBell((channel_t*)&chArray[m*numRThreads + r], &bellArray[r]);
+    }
+  }
+
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  // start all threads..
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+
+  // mallocating channel ID so that the thread can initialize before
+  // the for loop number changes
+  int * channelId = malloc(numRThreads*sizeof(int));
+  int * mapperId = malloc(numMappers*sizeof(int));
+
+  // every thread is pinned to the CPU of its slot (when -a is given)
+  pthread_attr_t attr;
+  pthread_barrier_init(&placed, NULL, numRThreads + 1);
+
+  for (int i = 0; i < numRThreads; i++)
+  {
+    channelId[i] = i;
+    if (cpuMap.attr(&cpuMap, numMappers + i, &attr) == -1 ||
+        pthread_create(&rthread[i], &attr, reducer, (void*)&channelId[i]) != 0)
+    {
+      printf("ERROR: Could not start reducer thread %d.\n", i);
+      return -1;
+    }
+    pthread_attr_destroy(&attr);
+  }
+
+  // the rings must not be moved once the mappers write to them
+  pthread_barrier_wait(&placed);
+
+  for (int i = 0; i < numMappers; i++)
+  {
+    mapperId[i] = i;
+    if (cpuMap.attr(&cpuMap, i, &attr) == -1 ||
+        pthread_create(&mthread[i], &attr, mapper, (void*)&mapperId[i]) != 0)
+    {
+      printf("ERROR: Could not start mapper thread %d.\n", i);
+      return -1;
+    }
+    pthread_attr_destroy(&attr);
+  }
+  
+  // Wait for threads to exit.. every mapper closes its channels when
+  // its input is done, which lets the reducers finish.
+  for (int i = 0; i < numMappers; i++)
+    pthread_join(mthread[i], NULL);
+  for (int i = 0; i < numRThreads; i++)
+    pthread_join(rthread[i], NULL);
+
+  debugger("MAIN - Exitting..", COMBINER_DEBUG_MODE);
+
+  // ordered mode.. every reducer's results in channel order, one writev
+  if (orderedOutput)
+    outputWriteAll(outArray, numRThreads, STDOUT_FD);
+  
+  // after all channel buffers have been read by reducer threads,
+  // channels may be deallocated.
+  for (int i = 0; i < numChannels; i++)
+    channelDestruct((channel_t*)&chArray[i]);
+  if (bellArray != NULL)
+  {
+    for (int i = 0; i < numRThreads; i++)
+      channelBellDestruct(&bellArray[i]);
+    free(bellArray);
+  }
+
+  free(rthread);
+  free(mthread);
+  free(channelId);
+  free(mapperId);
+  free(batch);
+  free(batchCount);
+  free(batchStart);
+  for (int i = 0; i < numMappers; i++)
+    routerDestruct(&rtArray[i]);
+  free(rtArray);
+
+  // stats report (stderr so the tuple output is unchanged)
+  if (showStats)
+  {
+    uint64_t lines = 0, writes = 0;
+    for (int i = 0; i < numRThreads; i++)
+    {
+      lines += outArray[i].lines;
+      writes += outArray[i].writes;
+    }
+    if (aggArray != NULL)
+    {
+      uint64_t tuplesIn = 0, tuplesOut = 0;
+      for (int i = 0; i < numMappers; i++)
+      {
+        tuplesIn += aggArray[i].tuplesIn;
+        tuplesOut += aggArray[i].tuplesOut;
+      }
+      fprintf(stderr, "pre-aggregation: mapped=%llu sent=%llu (%.1fx fewer)\n",
+              (unsigned long long)tuplesIn, (unsigned long long)tuplesOut,
+              tuplesOut ? (double)tuplesIn / tuplesOut : 0.0);
+    }
+
+    if (spillArray != NULL)
+    {
+      uint64_t runs = 0, records = 0;
+      size_t peak = 0;
+      for (int i = 0; i < numRThreads; i++)
+      {
+        runs += spillArray[i].runs;
+        records += spillArray[i].records;
+        peak += spillArray[i].peak;
+      }
+      fprintf(stderr, "spill: runs=%llu records=%llu peak=%lluKB\n",
+              (unsigned long long)runs, (unsigned long long)records, (unsigned long long)(peak >> 10));
+    }
+
+    if (sortArray != NULL)
+      fprintf(stderr, "sort: tuples=%llu runs=%llu threads=%d\n",
+              (unsigned long long)sortArray->tuples, (unsigned long long)sortArray->runs, sortArray->numThreads);
+
+    if (scheduler != NULL)
+    {
+      steal_stats_t work;
+      stealStats(scheduler, &work);
+      fprintf(stderr, "steal: tasks=%llu stolen=%llu (%.1f%%)\n",
+              (unsigned long long)work.tasks, (unsigned long long)work.stolen,
+              work.tasks ? 100.0 * work.stolen / work.tasks : 0.0);
+    }
+
+    fprintf(stderr, "output: lines=%llu writes=%llu (%.4f per line)\n",
+            (unsigned long long)lines, (unsigned long long)writes,
+            lines ? (double)writes / lines : 0.0);
+  }
+  for (int i = 0; i < numRThreads; i++)
+    outputDestruct(&outArray[i]);
+  free(outArray);
+  free(aggArray);
+  if (spillArray != NULL)
+  {
+    for (int i = 0; i < numRThreads; i++)
+      spillDestruct(&spillArray[i]);
+    free(spillArray);
+  }
+  if (sortArray != NULL)
+  {
+    xsortDestruct(sortArray);
+    free(sortArray);
+  }
+  if (scheduler != NULL)
+  {
+    stealDestruct(scheduler);
+    free(scheduler);
+  }
+  for (int i = 0; i < numMappers; i++)
+    parserDestruct(&inputArray[i]);
+  free(inputArray);
+  if (inputPath != NULL)
+    close(inputFd);
+  free((void*)chArray);
+  pthread_barrier_destroy(&placed);
+  return 0;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                       THREADS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: mapper
+ * This function maps an input tuple into a different tuple
+ * using the rules defined below. The generated tuple is immediately
+ * output to the terminal.
+ * 
+ * RULES:
+ * P = 50, L = 20, D = -10, C = 30, S = 40
+ * 
+ * EXAMPlE INPUT:   (1111,P,history)
+ * EXAMPLE OUTPUT:  (1111,history,50)
+ *
+ * NOTE: Mapped tuples are collected in a per-channel batch and handed
+ * to the channel with a single write_batch call once the batch is full
+ * or its oldest tuple is older than MAPPER_FLUSH_USEC. Ages are only
+ * checked as new tuples arrive, and at most once per MAPPER_FLUSH_USEC
+ * so the scan stays cheap with many channels; everything is flushed
+ * at EOF.
+ *
+ * NOTE: In shard mode there is one mapper per byte range of the input
+ * file. Mapper m only uses its own parser, router, batches and channels
+ * (chArray[m*numRThreads ..]), so the mappers share nothing.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+void* mapper(void* mapperNumAddr)
+{
+  debugger("Starting MAPPER..", COMBINER_DEBUG_MODE);
+
+  int mapperNum = *(int*)mapperNumAddr;
+  int firstCh = mapperNum*numRThreads;
+  parser_t* input = &inputArray[mapperNum];
+  aggregate_t* partial = (aggArray != NULL) ? &aggArray[mapperNum] : NULL;
+  xsort_t* sorter = sortArray;
+  uint64_t lastAgeCheck = nowUsec();
+  mTupleIn_t inputTuples[PARSER_BATCH_SIZE];
+  mTupleOut_t outputTuples[PARSER_BATCH_SIZE];
+  int numTuples;
+
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  // ** GET NEW TUPLE VALUES **
+  // The parser reads the std input in large blocks and hands back up
+  // to PARSER_BATCH_SIZE valid tuples at a time. Malformed tuples are
+  // skipped. 0 tuples means EOF, which notifies the reducer threads below.
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  while ((numTuples = input->read(input, inputTuples, PARSER_BATCH_SIZE)) > 0)
+  {
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    // ** MAPPING DATA AND STORING TO CHANNEL QUEUE **
+    // map the whole batch in one pass.. tuples with an unknown action
+    // are dropped and the rest are packed at the front of 'outputTuples'.
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    numTuples = mapBatch(inputTuples, outputTuples, numTuples);
+
+    // one clock read per batch drives the batch-age flush
+    uint64_t now = nowUsec();
+    for (int t = 0; t < numTuples; t++)
+    {
+      mTupleOut_t* outTuple = &outputTuples[t];
+
+      // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+      // ** EXTERNAL SORT (-x) **
+      // Collect the tuples in the sorter until EOF. Otherwise they go
+      // to the reducers right away.
+      // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+      if (sorter != NULL)
+      {
+        if (sorter->add(sorter, outTuple) == -1)
+          printf("ERROR: Could not write a sort run.\n");
+      }
+      else
+        sendTuple(mapperNum, outTuple, now, &lastAgeCheck);
+    }
+  }  
+
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  // ** SEND THE SORTED TUPLES (-x) **
+  // Every user's tuples now arrive together, in input order.
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  if (sorter != NULL)
+  {
+    mTupleOut_t sorted[PARSER_BATCH_SIZE];
+    while ((numTuples = sorter->read(sorter, sorted, PARSER_BATCH_SIZE)) > 0)
+    {
+      uint64_t now = nowUsec();
+      for (int t = 0; t < numTuples; t++)
+        sendTuple(mapperNum, &sorted[t], now, &lastAgeCheck);
+    }
+    if (numTuples == -1)
+      printf("ERROR: Could not merge the sort runs.\n");
+  }
+
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  // ** FREE ALL MEMORY ALLOCATED DATA **
+  // Send the last partial sums and flush what is left in the batches.
+  // Close this mapper's channels to wake the reducer threads (EOF).
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  if (partial != NULL)
+    sendPartials(mapperNum, nowUsec());
+
+  for (int i = firstCh; i < firstCh + numRThreads; i++)
+    flushBatch(i);
+
+  for (int i = firstCh; i < firstCh + numRThreads; i++)
+    chArray[i].close((channel_t*)&chArray[i]);
+
+  return NULL;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: reducer
+ * This process runs the reducer program and routes the 
+ * standard input to pipe.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void* reducer(void* channelNumAddr)
+{
+  debugger("Starting REDUCER..", COMBINER_DEBUG_MODE);
+
+  int channelNum = *(int*)channelNumAddr;
+  channel_t* ch = (channel_t*)&chArray[channelNum];
+  mTupleOut_t buffer[MAPPER_BATCH_SIZE];
+  int numRead;
+  dict_t * dictionary = NULL;
+  output_t* out = &outArray[channelNum];
+
+  // first touch.. move this reducer's rings and output buffer to the
+  // memory node of the CPU it runs on, then let the mappers start.
+  for (int m = 0; m < numMappers; m++)
+    channelPlace((channel_t*)&chArray[m*numRThreads + channelNum]);
+  outputPlace(out);
+  pthread_barrier_wait(&placed);
+
+  if (inputPath != NULL)
+    return reducerMerge(channelNum);
+  if (spillArray != NULL)
+    return reducerSpill(channelNum);
+  if (scheduler != NULL)
+    return reducerSteal(channelNum);
+
+  // initialize the user ID
+  char currId[LEN_USER_ID];
+  char prevId[LEN_USER_ID];
+  for (uint16_t i = 0; i < LEN_USER_ID; i++)
+  {
+    currId[i] = 'X';
+    prevId[i] = 'Y';
+  }
+
+  // read in tuples from the channel ring, as many as are available at a
+  // time. This thread sleeps while the ring is empty and the loop ends
+  // once the mapper closes the channel and every tuple has been read.
+  while ((numRead = ch->read_batch(ch, buffer, MAPPER_BATCH_SIZE)) > 0)
+  {
+    for (int n = 0; n < numRead; n++)
+    {
+      rTupleIn_t* tuple = (rTupleIn_t*)&buffer[n];
+
+      // update the current user id and check if it's still
+      // equal to the previous user id.
+      copyUserId(currId, tuple->userid);
+
+      // check if this is a new id.. if yes, clear out the dictionary 
+      // and reinitialize the data structure
+      if (compareUserId(currId, prevId) == -1)
+      {
+        // add all contents of the hash map to this reducer's output
+        r_console_tuple_write(out, prevId, dictionary);
+
+        // deallocate heap memory for hash map
+        dictFreeNodes(dictionary);
+
+        // initialize a new hash map
+        dictionary = dict();
+      }
+
+      // store the new tuple value in the hash map
+      reduce(dictionary, tuple);
+
+      // update the previous user id with the new user id
+      copyUserId(prevId, currId);
+
+#if REDUCER_DEBUG_MODE == 1
+      // display the contents of the dictionary to see if elements are being
+      // added correctly.
+      dictDisplayContents(dictionary);
+#endif
+    }
+  }
+
+  // final check to make sure dictionary was deallocated before exit.
+  // unordered output is written out now, ordered output by main.
+  r_console_tuple_write(out, currId, dictionary);
+  if (!out->hold)
+    outputFlush(out);
+
+  dictFreeNodes(dictionary);
+
+  debugger("Reducer exitting..", REDUCER_DEBUG_MODE);
+  return NULL;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                       PRIVATE FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: reducerMerge
+ * shard mode reducer. Reads from the channel of every mapper,
+ * whichever has tuples, and reduces each mapper's tuples into
+ * partial results. Once all mappers are done the partial results
+ * are merged in shard order (see merge.c) and written out.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static void* reducerMerge(int channelNum)
+{
+  channel_t** chs = (channel_t**)malloc(numMappers*sizeof(channel_t*));
+  mTupleOut_t buffer[MAPPER_BATCH_SIZE];
+  output_t* out = &outArray[channelNum];
+  merge_t results;
+  int numRead;
+  int shard = -1;
+
+  if (chs == NULL || merge(&results, numMappers) == -1)
+  {
+    printf("ERROR: Out of memory in reducer.\n");
+    return NULL;
+  }
+
+  for (int m = 0; m < numMappers; m++)
+    chs[m] = (channel_t*)&chArray[m*numRThreads + channelNum];
+
+  // 'shard' is the mapper whose channel the batch came from
+  while ((numRead = channelReadAny(chs, numMappers, &shard, buffer, MAPPER_BATCH_SIZE)) > 0)
+  {
+    for (int n = 0; n < numRead; n++)
+      results.add(&results, shard, (rTupleIn_t*)&buffer[n]);
+  }
+
+  results.write(&results, out);
+  if (!out->hold)
+    outputFlush(out);
+
+  mergeDestruct(&results);
+  free(chs);
+  return NULL;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: reducerSpill
+ * unsorted input reducer (-u). Tuples are reduced into the
+ * reducer's user table no matter in which order the users
+ * arrive; the table spills to a temp file when it outgrows its
+ * share of the budget. Once the channel is closed every user is
+ * written once, in user id order (see spill.c).
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static void* reducerSpill(int channelNum)
+{
+  channel_t* ch = (channel_t*)&chArray[channelNum];
+  mTupleOut_t buffer[MAPPER_BATCH_SIZE];
+  output_t* out = &outArray[channelNum];
+  spill_t* table = &spillArray[channelNum];
+  int numRead;
+  int error = 0;
+
+  while ((numRead = ch->read_batch(ch, buffer, MAPPER_BATCH_SIZE)) > 0)
+  {
+    for (int n = 0; n < numRead && !error; n++)
+      error = table->add(table, buffer[n].userid, buffer[n].topic, buffer[n].weight);
+  }
+
+  if (error || table->write(table, out) == -1)
+    printf("ERROR: Reducer could not spill to a temp file.\n");
+  if (!out->hold)
+    outputFlush(out);
+
+  return NULL;
+}
+
+// what an idle -W reducer sleeps on, see stealWaitReady
+typedef struct stealWait
+{
+  int worker;
+  channel_t* ch;
+  int open;
+} steal_wait_t;
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: reducerSteal
+ * work stealing reducer (-W). Tuples read from the channel are
+ * queued as tasks on this reducer's deque (see steal.c). Between
+ * reads the reducer runs its own tasks, or steals tasks of busier
+ * reducers when it has none, and writes its finished tasks in
+ * channel order. It sleeps on the scheduler's bell when there is
+ * nothing to read, run or write.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static void* reducerSteal(int channelNum)
+{
+  channel_t* ch = (channel_t*)&chArray[channelNum];
+  mTupleOut_t buffer[STEAL_TASK_SIZE];
+  output_t* out = &outArray[channelNum];
+  steal_t* s = scheduler;
+  steal_wait_t wait = {channelNum, ch, 1};
+  int fill = 0;
+
+  while (1)
+  {
+    int numRead = 0;
+    int room = s->room(s, channelNum) - fill;
+
+    // collect a full task from the channel while there is room for it
+    if (wait.open && room > 0)
+    {
+      int max = STEAL_TASK_SIZE - fill;
+      numRead = ch->try_read_batch(ch, &buffer[fill], (room < max) ? room : max);
+      if (numRead > 0)
+        fill += numRead;
+      else if (numRead < 0)
+        wait.open = 0;
+    }
+    if (fill == STEAL_TASK_SIZE || (!wait.open && fill > 0))
+      fill = stealQueue(s, channelNum, buffer, fill);
+    if (numRead < 0)
+      s->close(s);
+
+    int ran = s->run(s, channelNum, out);
+
+    // nothing else to do.. queue the partial task instead of waiting
+    if (!ran && numRead == 0 && fill > 0)
+    {
+      fill = stealQueue(s, channelNum, buffer, fill);
+      ran = s->run(s, channelNum, out);
+    }
+
+    int pending = s->write(s, channelNum, out);
+
+    // done once every channel is drained and all own tasks are written
+    if (!wait.open && pending == 0 && stealDone(s))
+      break;
+
+    if (numRead <= 0 && !ran)
+      channelBellWait(&s->bell, stealWaitReady, &wait);
+  }
+
+  s->finish(s, channelNum, out);
+  if (!out->hold)
+    outputFlush(out);
+
+  return NULL;
+}
+
+// queue the collected tuples, returns the new fill (0)
+static int stealQueue(steal_t* s, int worker, mTupleOut_t* tuples, int n)
+{
+  if (s->push(s, worker, tuples, n) == -1)
+    printf("ERROR: Out of memory in reducer.\n");
+  return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: stealWaitReady
+ * wake up condition of an idle -W reducer: tuples (or the end)
+ * on its channel that it has room for, or work in the scheduler.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static int stealWaitReady(void* arg)
+{
+  steal_wait_t* wait = (steal_wait_t*)arg;
+
+  if (wait->open && scheduler->room(scheduler, wait->worker) > 0 && channelReady(wait->ch) != 0)
+    return 1;
+  return scheduler->ready(scheduler, wait->worker);
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: nowUsec
+ * monotonic time in microseconds, used to age the batches.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static uint64_t nowUsec()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: flushBatch
+ * writes every tuple batched for channel chArray[chIndex] with a
+ * single write_batch call and empties the batch.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static int flushBatch(int chIndex)
+{
+  channel_t* ch = (channel_t*)&chArray[chIndex];
+  int writeErr = 0;
+
+  if (batchCount[chIndex] == 0)
+    return 0;
+
+  if ((writeErr = ch->write_batch(ch, &batch[chIndex*batchSize], batchCount[chIndex])) < 0)
+    printf("ERROR: Writing to a closed channel.\n");
+
+  batchCount[chIndex] = 0;
+  return writeErr;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: batchTuples
+ * routes 'n' tuples of the same user and appends copies of them to
+ * that channel's batch. A batch is written out as soon as it is full.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static void batchTuples(int mapperNum, mTupleOut_t* tuples, int n, uint64_t now)
+{
+  router_t* rt = &rtArray[mapperNum];
+  int chIndex;
+
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  // ** CHOOSE WHICH CHANNEL TO WRITE TUPLES TO **
+  // The router hashes the user id into its user map. A user seen for
+  // the first time is assigned a channel using the selected policy.
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  if ((chIndex = rt->route(rt, tuples[0].userid)) < 0)
+  {
+    printf("ERROR: Could not route user id.\n");
+    return;
+  }
+  chIndex += mapperNum*numRThreads;
+
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  // ** FLUSH BATCHES TO THE CHANNELS **
+  // The channel is owned by this thread on the write side, so no lock is
+  // needed. Sleeps only while the reducer has the ring full.
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  for (int i = 0; i < n; i++)
+  {
+    if (batchCount[chIndex] == 0)
+      batchStart[chIndex] = now;
+    batch[chIndex*batchSize + batchCount[chIndex]++] = tuples[i];
+
+    if (batchCount[chIndex] == batchSize)
+      flushBatch(chIndex);
+  }
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: sendTuple
+ * hands one mapped tuple to the reducers' batches, through the
+ * pre-aggregation table with -c, and flushes batches that got
+ * too old. 'lastAgeCheck' is the mapper's time of the last scan.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static void sendTuple(int mapperNum, mTupleOut_t* tuple, uint64_t now, uint64_t* lastAgeCheck)
+{
+  aggregate_t* partial = (aggArray != NULL) ? &aggArray[mapperNum] : NULL;
+  int firstCh = mapperNum*numRThreads;
+
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  // ** PRE-AGGREGATE (-c) **
+  // Sum the weights of the current user per topic. The partial sums
+  // go to the channel when the user changes, the table is full or
+  // at EOF. Without -c every mapped tuple is sent as is.
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  if (partial != NULL)
+  {
+    if (partial->add(partial, tuple) < 0)
+    {
+      sendPartials(mapperNum, now);
+      partial->add(partial, tuple);
+    }
+  }
+  else
+    batchTuples(mapperNum, tuple, 1, now);
+
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  // ** FLUSH OLD BATCHES TO THE CHANNELS **
+  // Full batches were already written by batchTuples. Partial sums
+  // of a user that is still being read are sent here too, so a slow
+  // input still reaches the reducers.
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  if (now - *lastAgeCheck >= MAPPER_FLUSH_USEC)
+  {
+    if (partial != NULL)
+      sendPartials(mapperNum, now);
+
+    for (int i = firstCh; i < firstCh + numRThreads; i++)
+    {
+      if (batchCount[i] > 0 && now - batchStart[i] >= MAPPER_FLUSH_USEC)
+        flushBatch(i);
+    }
+    *lastAgeCheck = now;
+  }
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: sendPartials
+ * drains the mapper's pre-aggregation table into the batch of the
+ * user's channel.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static void sendPartials(int mapperNum, uint64_t now)
+{
+  aggregate_t* partial = &aggArray[mapperNum];
+  mTupleOut_t* tuples;
+  int n;
+
+  if ((n = partial->drain(partial, &tuples)) > 0)
+    batchTuples(mapperNum, tuples, n, now);
+}
@@ -0,0 +1,213 @@
+/*
+ * SUMMARY: dictBench.c
+ * Microbenchmark comparing the open addressing dictionary against the
+ * linked list dictionary it replaced. Both maps are fed the same random
+ * sequence of topics and the time per dictAddToValue call is reported.
+ *
+ * USAGE: ./dictBench [numTopics] [numOps]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "common.h"
+#include "dictionary.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           DEFINES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+#define DEFAULT_NUM_TOPICS  1000
+#define DEFAULT_NUM_OPS     1000000
+#define BENCH_SEED          5733
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           TYPEDEFS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+// Copy of the original linked list dictionary node (see git history of
+// dictionary.c) so the two implementations can be compared side-by-side.
+typedef struct chainNode
+{
+    uint8_t valid;
+    char key[LEN_TOPIC];
+    int32_t value;
+    struct chainNode * next;
+} chain_t;
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                       LINKED LIST MAP
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+static chain_t* chain()
+{
+    chain_t* map = malloc(sizeof(chain_t));
+    map->valid = 0;
+    map->value = 0;
+    map->next = NULL;
+    return map;
+}
+
+static chain_t* chainAddToValue(chain_t* map, char* key, int32_t value)
+{
+    chain_t* iter = map;
+
+    if (!map->valid)
+    {
+        map->valid = 1;
+        map->value = value;
+        memcpy(map->key, key, LEN_TOPIC);
+        return map;
+    }
+
+    // walk every node comparing the key byte-by-byte.
+    while (1)
+    {
+        uint8_t equal = 1;
+        for (uint8_t i = 0; i < LEN_TOPIC; i++)
+        {
+            if (key[i] != iter->key[i])
+            {
+                equal = 0;
+                break;
+            }
+        }
+
+        if (equal)
+        {
+            iter->value += value;
+            return iter;
+        }
+
+        if (iter->next == NULL)
+            break;
+        iter = iter->next;
+    }
+
+    chain_t* node = malloc(sizeof(chain_t));
+    node->valid = 1;
+    node->value = value;
+    node->next = NULL;
+    memcpy(node->key, key, LEN_TOPIC);
+    iter->next = node;
+    return node;
+}
+
+static void chainFree(chain_t* map)
+{
+    while (map != NULL)
+    {
+        chain_t* next = map->next;
+        free(map);
+        map = next;
+    }
+}
+
+static int64_t chainChecksum(chain_t* map)
+{
+    int64_t sum = 0;
+    for (; map != NULL; map = map->next)
+        sum += map->value;
+    return sum;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+static double elapsedSeconds(struct timespec* start, struct timespec* end)
+{
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                              MAIN
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+int main(int argc, char **argv)
+{
+    int numTopics = (argc > 1) ? atoi(argv[1]) : DEFAULT_NUM_TOPICS;
+    int numOps = (argc > 2) ? atoi(argv[2]) : DEFAULT_NUM_OPS;
+    struct timespec start, end;
+
+    if (numTopics <= 0 || numOps <= 0)
+    {
+        printf("ERROR: Expecting ./dictBench [numTopics] [numOps]\n");
+        return -1;
+    }
+
+    // build the topic strings the same way the input files pad them.
+    char (*topics)[LEN_TOPIC] = malloc(numTopics * LEN_TOPIC);
+    for (int i = 0; i < numTopics; i++)
+    {
+        char temp[LEN_TOPIC + 1];
+        snprintf(temp, sizeof(temp), "topic%-10d", i);
+        memcpy(topics[i], temp, LEN_TOPIC);
+    }
+
+    // pre-generate the access sequence so rand() is not timed.
+    int* sequence = malloc(numOps * sizeof(int));
+    srand(BENCH_SEED);
+    for (int i = 0; i < numOps; i++)
+        sequence[i] = rand() % numTopics;
+
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    // linked list map
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    chain_t* chainMap = chain();
+    for (int i = 0; i < numOps; i++)
+        chainAddToValue(chainMap, topics[sequence[i]], RULE_WEIGHT[i % MAPPING_COUNT]);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double chainTime = elapsedSeconds(&start, &end);
+    int64_t chainSum = chainChecksum(chainMap);
+    chainFree(chainMap);
+
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    // open addressing map
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    dict_t* map = dict();
+    for (int i = 0; i < numOps; i++)
+        dictAddToValue(map, topics[sequence[i]], RULE_WEIGHT[i % MAPPING_COUNT]);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double dictTime = elapsedSeconds(&start, &end);
+    int64_t dictSum = 0;
+    for (uint32_t i = 0; i < map->count; i++)
+        dictSum += map->entries[i].value;
+    dictFreeNodes(map);
+
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    // report
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    printf("topics=%d ops=%d\n", numTopics, numOps);
+    printf("%-8s %12s %12s\n", "map", "ns/op", "checksum");
+    printf("%-8s %12.1f %12lld\n", "chain", chainTime * 1e9 / numOps, (long long)chainSum);
+    printf("%-8s %12.1f %12lld\n", "hash", dictTime * 1e9 / numOps, (long long)dictSum);
+    printf("speedup  %11.1fx\n", chainTime / dictTime);
+
+    if (chainSum != dictSum)
+    {
+        printf("ERROR: Checksums do not match.\n");
+        return -1;
+    }
+
+    free(sequence);
+    free(topics);
+    return 0;
+}
@@ -1,190 +1,314 @@
-/*
- * SUMMARY: dictionary.c
- * This file contains functions for a map data structure used for 
- * advanced systems programming assignment 1. The key is a 15 character
- * long string and the value contains the current total weight of the 
- * key.
- */
-
-#include "dictionary.h"
-
-/*
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
- *                           FUNCTIONS
- * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
- */
-
-/*
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
- * SUMMARY: dict
- * Constructor for the dictionary data structure. This function
- * initializes a node but does not fill it with value keys/values.
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
- */
-node_t* dict()
-{
-    node_t* map = malloc(sizeof(node_t));
-    
-    // fill the initial map values to invalid data
-    map->valid = 0;
-    map->value = 0;
-    map->next = NULL;
-    for (uint16_t i = 0; i < LEN_TOPIC; i++)
-        map->key[i] = 'X';
-
-    return map;
-}
-
-/*
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
- * SUMMARY: dictAddToValue
- * This function adds input data to the currently stored key value.
- * If the key does not exist yet, it will be added and the value will
- * be initialized to 0. 
- * 
- * NOTE: NULL is returned if new data cannot be allocated.
- * RETURN: pointer to the node that was changed.
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
- */
-node_t* dictAddToValue(node_t* map, char* key, int32_t value)
-{
-    node_t * iter = map; // iteration pointer
-
-    // check if the intial node is valid. If not, create the first node 
-    // values.
-    if (!map->valid)
-    {
-        map->valid = 1; // make sure the map is valid for future accesses
-        map->value = value;
-        for (uint8_t i = 0; i < LEN_TOPIC; i++)
-            map->key[i] = key[i];
-        return map;
-    }
-
-    // search for keys that are equal to the requested key.
-    while (1)
-    {
-        uint8_t stringsAreEqual = dictCompareStrings(key, iter->key);
-
-        // If strings are equal, add the new value to the original value
-        // and return a pointer to the node.
-        if (stringsAreEqual)
-        {
-            iter->value += value;
-            return iter;
-        }
-
-        // continue searching until the final value of the linked list
-        // is found.. save this iteration's pointer as the final node
-        // pointer for the next section.
-        if (iter->next != NULL)
-            iter = iter->next;
-        else
-            break;
-    }
-
-    // the key was never found, so the new node should be added.
-    node_t * newNode = (node_t*)malloc(sizeof(node_t));
-    
-    if (newNode == NULL) // Memory allocation failed.. return error.
-    {
-        printf("ERROR: No dynamic memory to allocate, line 82");
-        return NULL;
-    }
-    else
-    {
-        // initialize new node..
-        newNode->valid = 1;
-        newNode->value = value;
-        newNode->next = NULL;
-        for (uint16_t i = 0; i < LEN_TOPIC; i++)
-            newNode->key[i] = key[i];
-        
-        // point the last node at the new node
-        iter->next = newNode;
-        
-        return newNode;
-    }
-}
-
-/*
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
- * SUMMARY: dictFreeNodes
- * Frees all dynamically allocated memory for the hash table.
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
- */
-void dictFreeNodes(node_t * firstNode)
-{
-    // exit if passed a null pointer
-    if (firstNode == NULL)
-        return;
-
-    do
-    {
-        // first node always points at the next node so that the 
-        // node to erase can be deleted.
-        node_t * nodeToErase = firstNode;
-        firstNode = firstNode->next;
-
-#if DICTIONARY_DEBUG == 1
-        printf("********** DELETING KEY ************\n");
-        char string[LEN_TOPIC + 10]; // enough space to store topic string and large number
-        char tempStr[LEN_TOPIC];     // buffer holds initial string
-        snprintf(tempStr, LEN_TOPIC, "%s", nodeToErase->key);
-        sprintf(string, "%s: %d", tempStr, nodeToErase->value);
-        printf("%s\n\n", string);
-#endif
-        
-        // free the current node..
-        free((void*)nodeToErase);
-
-    } while(firstNode != NULL);
-}
-
-/*
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
- * SUMMARY: dictDisplayContents
- * Displays keys and values to the terminal.
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
- */
-void dictDisplayContents(node_t* node)
-{
-    printf("+-------------------------------------------+\n");
-    printf("|            DICTIONARY CONTENTS            |\n");
-    printf("+-------------------------------------------+\n");
-
-    // continue displaying the map contents until the end of the
-    // linked list is found.
-    while (node != NULL)
-    {
-        char string[LEN_TOPIC + 10]; // enough space to store topic string and large number
-        char tempStr[LEN_TOPIC];     // buffer holds initial string
-
-        snprintf(tempStr, LEN_TOPIC, "%s", node->key);
-        sprintf(string, "%s: %d", tempStr, node->value);
-        printf("%s\n", string);
-        node = node->next;
-    }
-}
-
-/*
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
- * SUMMARY: dictCompareStrings
- * Compare two strings to see if they are matching topics.
- * Returns 1 for true, 0 for false
- * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
- */
-uint8_t dictCompareStrings(char* a, char* b)
-{
-    uint8_t result = 1;
-    for (uint8_t i = 0; i < LEN_TOPIC; i++)
-    {
-        if (a[i] != b[i])
-        {
-            result = 0;
-            break;
-        }
-    }
-
-    return result;
+/*
+ * SUMMARY: dictionary.c
+ * This file contains functions for a map data structure used for
+ * advanced systems programming assignment 1. The key is a 15 character
+ * long string and the value contains the current total weight of the
+ * key.
+ *
+ * NOTE: The map is a flat open addressing hash table. Key/value slots
+ * live in one contiguous array (in insertion order) and the hash table
+ * only stores indices into that array, so a lookup is a hash plus a
+ * short linear probe instead of a walk over every topic.
+ *
+ * NOTE: Keys are stored as packed topic_key_t blocks (common.h), so a
+ * probe compares two 64-bit words instead of 15 characters.
+ */
+
+#include "dictionary.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+static int32_t* _dictIndexAlloc(uint32_t size);
+static void _dictIndexInsert(int32_t* index, uint32_t mask, uint32_t hash, int32_t slot);
+static int32_t _dictIndexFind(dict_t* map, int32_t* index, uint32_t mask, topic_key_t* key, uint32_t hash);
+static void _dictRehashStep(dict_t* map, uint32_t steps);
+static int32_t _dictGrow(dict_t* map);
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: dict
+ * Constructor for the dictionary data structure. This function
+ * allocates an empty map with room for DICT_INIT_CAPACITY buckets.
+ *
+ * NOTE: NULL is returned if the map cannot be allocated.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+dict_t* dict()
+{
+    dict_t* map = malloc(sizeof(dict_t));
+    if (map == NULL)
+        return NULL;
+
+    // entries are only allowed to fill 3/4 of the index before it grows,
+    // so the slot array never needs to be larger than that.
+    map->count = 0;
+    map->capacity = (DICT_INIT_CAPACITY * 3) / 4;
+    map->entries = malloc(map->capacity * sizeof(entry_t));
+
+    map->mask = DICT_INIT_CAPACITY - 1;
+    map->index = _dictIndexAlloc(DICT_INIT_CAPACITY);
+
+    map->oldIndex = NULL;
+    map->oldMask = 0;
+    map->rehashPos = 0;
+
+    if (map->entries == NULL || map->index == NULL)
+    {
+        dictFreeNodes(map);
+        return NULL;
+    }
+
+    return map;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: dictAddToValue
+ * This function adds input data to the currently stored key value.
+ * If the key does not exist yet, it will be added and the value will
+ * be initialized to the input value.
+ *
+ * NOTE: NULL is returned if new data cannot be allocated.
+ * NOTE: The returned pointer is only valid until the next insert,
+ * since growing the map may move the slot array.
+ * RETURN: pointer to the entry that was changed.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+entry_t* dictAddToValue(dict_t* map, char* key, int32_t value)
+{
+    uint32_t hash = dictHash(key);
+    topic_key_t packed = topicKey(key);
+
+    // move part of the old index over if a resize is in progress.
+    if (map->oldIndex != NULL)
+        _dictRehashStep(map, DICT_REHASH_STEP);
+
+    // search the current index first, then any index still being migrated.
+    int32_t slot = _dictIndexFind(map, map->index, map->mask, &packed, hash);
+    if (slot == DICT_EMPTY && map->oldIndex != NULL)
+        slot = _dictIndexFind(map, map->oldIndex, map->oldMask, &packed, hash);
+
+    // key found.. add the new value to the original value.
+    if (slot != DICT_EMPTY)
+    {
+        map->entries[slot].value += value;
+        return &map->entries[slot];
+    }
+
+    // the key was never found, so a new slot should be added.
+    if (map->count == map->capacity && _dictGrow(map) == -1)
+    {
+        printf("ERROR: No dynamic memory to allocate (dictAddToValue)");
+        return NULL;
+    }
+
+    entry_t* entry = &map->entries[map->count];
+    entry->hash = hash;
+    entry->value = value;
+    entry->key = packed;
+
+    _dictIndexInsert(map->index, map->mask, hash, (int32_t)map->count);
+    map->count++;
+
+    return entry;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: dictFreeNodes
+ * Frees all dynamically allocated memory for the hash table.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void dictFreeNodes(dict_t* map)
+{
+    // exit if passed a null pointer
+    if (map == NULL)
+        return;
+
+#if DICTIONARY_DEBUG == 1
+    printf("********** DELETING MAP ************\n");
+    dictDisplayContents(map);
+#endif
+
+    free(map->entries);
+    free(map->index);
+    free(map->oldIndex);
+    free(map);
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: dictDisplayContents
+ * Displays keys and values to the terminal.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void dictDisplayContents(dict_t* map)
+{
+    printf("+-------------------------------------------+\n");
+    printf("|            DICTIONARY CONTENTS            |\n");
+    printf("+-------------------------------------------+\n");
+
+    if (map == NULL)
+        return;
+
+    // display the map contents in the order they were inserted.
+    for (uint32_t i = 0; i < map->count; i++)
+        printf("%.*s: %d\n", LEN_TOPIC, map->entries[i].key.text, map->entries[i].value);
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: dictHash
+ * FNV-1a hash of a LEN_TOPIC character key.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+uint32_t dictHash(char* key)
+{
+    uint32_t hash = 2166136261u;
+    for (uint8_t i = 0; i < LEN_TOPIC; i++)
+    {
+        hash ^= (uint8_t)key[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                       PRIVATE FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _dictIndexAlloc
+ * Allocates an index table with every bucket marked DICT_EMPTY.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static int32_t* _dictIndexAlloc(uint32_t size)
+{
+    int32_t* index = malloc(size * sizeof(int32_t));
+    if (index != NULL)
+        memset(index, 0xFF, size * sizeof(int32_t)); // 0xFFFFFFFF == DICT_EMPTY
+    return index;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _dictIndexInsert
+ * Stores a slot number in the first free bucket at or after
+ * the key's home bucket.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static void _dictIndexInsert(int32_t* index, uint32_t mask, uint32_t hash, int32_t slot)
+{
+    uint32_t bucket = hash & mask;
+    while (index[bucket] != DICT_EMPTY)
+        bucket = (bucket + 1) & mask;
+    index[bucket] = slot;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _dictIndexFind
+ * Probes an index table for the key. The precomputed hash is
+ * compared first so the full key is only compared on a likely hit.
+ *
+ * RETURN: slot number of the key, DICT_EMPTY if not found.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static int32_t _dictIndexFind(dict_t* map, int32_t* index, uint32_t mask, topic_key_t* key, uint32_t hash)
+{
+    uint32_t bucket = hash & mask;
+    int32_t slot;
+
+    while ((slot = index[bucket]) != DICT_EMPTY)
+    {
+        entry_t* entry = &map->entries[slot];
+        if (entry->hash == hash && topicKeyEqual(&entry->key, key))
+            return slot;
+        bucket = (bucket + 1) & mask;
+    }
+
+    return DICT_EMPTY;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _dictRehashStep
+ * Migrates up to 'steps' buckets from the old index into the
+ * current one. The old index is left intact (and still searched)
+ * until every bucket has been moved, then it is freed.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static void _dictRehashStep(dict_t* map, uint32_t steps)
+{
+    uint32_t oldSize = map->oldMask + 1;
+
+    for (; steps > 0 && map->rehashPos < oldSize; steps--, map->rehashPos++)
+    {
+        int32_t slot = map->oldIndex[map->rehashPos];
+        if (slot != DICT_EMPTY)
+            _dictIndexInsert(map->index, map->mask, map->entries[slot].hash, slot);
+    }
+
+    if (map->rehashPos == oldSize)
+    {
+        free(map->oldIndex);
+        map->oldIndex = NULL;
+        map->oldMask = 0;
+        map->rehashPos = 0;
+    }
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _dictGrow
+ * Doubles the slot array and starts an incremental resize of
+ * the index. An unfinished resize is completed first so there
+ * is never more than one old index.
+ *
+ * RETURN: 0 on success, -1 if memory could not be allocated.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static int32_t _dictGrow(dict_t* map)
+{
+    uint32_t newSize = (map->mask + 1) * 2;
+
+    // allocate both arrays before changing the map, so a failure
+    // leaves it exactly as it was.
+    int32_t* index = _dictIndexAlloc(newSize);
+    if (index == NULL)
+        return -1;
+
+    entry_t* entries = realloc(map->entries, ((newSize * 3) / 4) * sizeof(entry_t));
+    if (entries == NULL)
+    {
+        free(index);
+        return -1;
+    }
+
+    map->entries = entries;
+    map->capacity = (newSize * 3) / 4;
+
+    if (map->oldIndex != NULL)
+        _dictRehashStep(map, map->oldMask + 1);
+
+    map->oldIndex = map->index;
+    map->oldMask = map->mask;
+    map->rehashPos = 0;
+    map->index = index;
+    map->mask = newSize - 1;
+
+    return 0;
 }
\ No newline at end of file
@@ -29,27 +29,15 @@ typedef struct mTupleOut
     char topic[15];     // TOPIC - Pad this with space if unused.
     int32_t weight;     // WEIGHT - Value mapped from the input action as defined by the set of rules in 'main' summary.
 
-    struct mTupleOut* next; // FIFO implementation in channel.c
-    struct mTupleOut* prev; // FIFO implementation in channel.c
 } mTupleOut_t;
 
-typedef enum tupleItem
-{
-    ME_LEFT_BRACKET,
-    ME_USER_ID,
-    ME_ACTION,
-    ME_TOPIC,
-    ME_RIGHT_BRACKET
-} tupleItem_t;
-
 /*
  * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
  *                           PROTOTYPES
  * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
  */
 
-mTupleIn_t* m_console_tuple_read(void);
-mTupleOut_t* map(mTupleIn_t * in);
+int mapBatch(mTupleIn_t* in, mTupleOut_t* out, int n);
 
 
 #endif
\ No newline at end of file
@@ -0,0 +1,191 @@
+/*
+ * SUMMARY: merge
+ * This file combines the partial per-user results of a reducer that
+ * reads from several mappers, one input shard per mapper.
+ *
+ * NOTE: The single mapper reducer can print a user as soon as the user
+ * id changes because the input is grouped by user. With shards, the same
+ * user can reach the reducer from two mappers (a group that straddles a
+ * shard boundary) and the tuples of different shards are interleaved.
+ * Each shard's tuples are reduced into runs first; mergeWrite then adds
+ * the runs up per user, shard by shard, and writes every user once in
+ * the order it first appears in the file.
+ */
+
+#include "merge.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+static merge_run_t* _mergeNewRun(merge_t* m, int shard, char* userid);
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: merge
+ * initialize an empty merge for 'numShards' input shards.
+ *
+ * RETURN: 0 on success, -1 if memory cannot be allocated.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int merge(merge_t* m, int numShards)
+{
+    m->numShards = numShards;
+    m->_runs = (merge_run_t**)calloc(numShards, sizeof(merge_run_t*));
+    m->_numRuns = (int*)calloc(numShards, sizeof(int));
+    m->_capRuns = (int*)calloc(numShards, sizeof(int));
+    if (m->_runs == NULL || m->_numRuns == NULL || m->_capRuns == NULL)
+        return -1;
+
+    // connect functions
+    m->add = &mergeAdd;
+    m->write = &mergeWrite;
+    return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: mergeDestruct
+ * deallocate every run that was not written yet.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void mergeDestruct(merge_t* m)
+{
+    for (int s = 0; s < m->numShards; s++)
+    {
+        for (int i = 0; i < m->_numRuns[s]; i++)
+            dictFreeNodes(m->_runs[s][i].dictionary);
+        free(m->_runs[s]);
+    }
+
+    free(m->_runs);
+    free(m->_numRuns);
+    free(m->_capRuns);
+    m->_runs = NULL;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: mergeAdd -> connects to merge.add
+ * reduce a tuple that was read from the mapper of 'shard'. A new run
+ * is started whenever the user id differs from the shard's last run.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void mergeAdd(merge_t* m, int shard, rTupleIn_t* tuple)
+{
+    int numRuns = m->_numRuns[shard];
+    merge_run_t* run = (numRuns > 0) ? &m->_runs[shard][numRuns - 1] : NULL;
+
+    if (run == NULL || compareUserId(run->userid, tuple->userid) == -1)
+    {
+        if ((run = _mergeNewRun(m, shard, tuple->userid)) == NULL)
+        {
+            printf("ERROR: Out of memory for merge runs.\n");
+            return;
+        }
+    }
+
+    reduce(run->dictionary, tuple);
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: mergeWrite -> connects to merge.write
+ * adds the runs of every shard up per user, in shard order, and
+ * writes one result per user to 'out'. The runs are freed.
+ *
+ * NOTE: Users are indexed with a dictionary keyed by the space padded
+ * user id; its value is the user's slot in the 'users' array.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void mergeWrite(merge_t* m, output_t* out)
+{
+    int numUsers = 0;
+    int capUsers = MERGE_INIT_RUNS;
+    merge_run_t* users = (merge_run_t*)malloc(capUsers*sizeof(merge_run_t));
+    dict_t* index = dict();
+    char key[LEN_TOPIC];
+
+    for (int s = 0; s < m->numShards; s++)
+    {
+        for (int i = 0; i < m->_numRuns[s]; i++)
+        {
+            merge_run_t* run = &m->_runs[s][i];
+
+            // find the user's merged result, or append a new one
+            memset(key, SPACE, LEN_TOPIC);
+            memcpy(key, run->userid, LEN_USER_ID);
+            uint32_t count = index->count;
+            entry_t* entry = dictAddToValue(index, key, 0);
+
+            if (index->count != count)
+            {
+                if (numUsers == capUsers)
+                {
+                    capUsers *= 2;
+                    users = (merge_run_t*)realloc(users, capUsers*sizeof(merge_run_t));
+                }
+                entry->value = numUsers;
+                users[numUsers] = *run;
+                numUsers++;
+                continue;
+            }
+
+            // topics of a later run are added in the order they were seen
+            dict_t* total = users[entry->value].dictionary;
+            for (uint32_t e = 0; e < run->dictionary->count; e++)
+                dictAddToValue(total, run->dictionary->entries[e].key.text, run->dictionary->entries[e].value);
+            dictFreeNodes(run->dictionary);
+        }
+        m->_numRuns[s] = 0;
+    }
+
+    for (int u = 0; u < numUsers; u++)
+    {
+        r_console_tuple_write(out, users[u].userid, users[u].dictionary);
+        dictFreeNodes(users[u].dictionary);
+    }
+
+    dictFreeNodes(index);
+    free(users);
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                        PRIVATE FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _mergeNewRun
+ * appends an empty run for 'userid' to the shard's list of runs.
+ *
+ * RETURN: the new run, NULL if memory cannot be allocated.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static merge_run_t* _mergeNewRun(merge_t* m, int shard, char* userid)
+{
+    if (m->_numRuns[shard] == m->_capRuns[shard])
+    {
+        int cap = m->_capRuns[shard] ? 2*m->_capRuns[shard] : MERGE_INIT_RUNS;
+        merge_run_t* runs = (merge_run_t*)realloc(m->_runs[shard], cap*sizeof(merge_run_t));
+        if (runs == NULL)
+            return NULL;
+        m->_runs[shard] = runs;
+        m->_capRuns[shard] = cap;
+    }
+
+    merge_run_t* run = &m->_runs[shard][m->_numRuns[shard]++];
+    copyUserId(run->userid, userid);
+    run->dictionary = dict();
+    return run;
+}
@@ -0,0 +1,65 @@
+#ifndef _MERGE_SRC_HEADER_
+#define _MERGE_SRC_HEADER_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "common.h"
+#include "dictionary.h"
+#include "reducer.h"
+#include "output.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                            DEFINES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+#define MERGE_INIT_RUNS     64  // initial number of runs per shard
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           TYPEDEFS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+// A run is a stretch of tuples for one user within one shard, reduced
+// into its own (partial) dictionary.
+typedef struct mergeRun
+{
+    char userid[LEN_USER_ID];
+    dict_t* dictionary;
+} merge_run_t;
+
+// merge structure collects the partial results of one reducer when its
+// tuples come from several input shards. Runs are kept per shard in the
+// order they arrived and combined per user in shard order at the end, so
+// the result is the same as reducing the whole input in file order.
+typedef struct mergeStruct
+{
+    // public parameters
+    int numShards;
+
+    // functions
+    void (*add)(struct mergeStruct* m, int shard, rTupleIn_t* tuple); // reduce a tuple of 'shard'
+    void (*write)(struct mergeStruct* m, output_t* out);               // combine runs and write results
+
+    // private parameters
+    merge_run_t** _runs;    // runs of each shard, in arrival order
+    int* _numRuns;
+    int* _capRuns;
+} merge_t;
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+int merge(merge_t* m, int numShards);
+void mergeDestruct(merge_t* m);
+void mergeAdd(merge_t* m, int shard, rTupleIn_t* tuple);
+void mergeWrite(merge_t* m, output_t* out);
+
+#endif
@@ -0,0 +1,310 @@
+/*
+ * SUMMARY: output
+ * This file contains a buffered writer for reducer results. It replaces
+ * printing every character with putchar()/printf() on an unbuffered
+ * stdout, which cost 10+ system calls per output line.
+ *
+ * NOTE: Lines are formatted straight into the buffer (no sprintf) and
+ * the buffer is emitted with one write(2), so a 64KB buffer holds a few
+ * thousand lines per system call.
+ *
+ * NOTE: In 'hold' mode the buffer grows instead of being written out.
+ * outputWriteAll then emits several held buffers in array order with
+ * writev(2), which gives a deterministic order across threads.
+ */
+
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include "output.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                            DEFINES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+#ifndef IOV_MAX
+#define IOV_MAX             1024    // POSIX minimum is 16, Linux allows 1024
+#endif
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+static int _outputWritev(int fd, struct iovec* iov, int count, uint64_t* writes);
+static int _outputGrow(output_t* out);
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: output
+ * allocate the line buffer of a writer for 'fd'. 'lock' may be NULL
+ * when nothing else writes to 'fd' at the same time.
+ *
+ * RETURN: 0 on success, -1 if the buffer cannot be allocated.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int output(output_t* out, int fd, int hold, pthread_mutex_t* lock)
+{
+    out->fd = fd;
+    out->hold = hold;
+    out->lock = lock;
+    out->lines = 0;
+    out->writes = 0;
+    out->_len = 0;
+    out->_cap = OUTPUT_BUF_SIZE;
+    out->_buf = (char*)malloc(out->_cap);
+    if (out->_buf == NULL)
+        return -1;
+    return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: outputDestruct
+ * write out anything still buffered (unless held) and deallocate
+ * the buffer.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void outputDestruct(output_t* out)
+{
+    if (!out->hold)
+        outputFlush(out);
+
+    free(out->_buf);
+    out->_buf = NULL;
+    out->_len = 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: outputPlace
+ * re-allocate the (empty) buffer from the calling thread and touch
+ * it, so it lives on the NUMA node of the thread that formats into it.
+ *
+ * RETURN: 0 on success, -1 if the new buffer cannot be allocated.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int outputPlace(output_t* out)
+{
+    char* buf = (char*)malloc(out->_cap);
+    if (buf == NULL)
+        return -1;
+
+    memset(buf, 0, out->_cap);
+    memcpy(buf, out->_buf, out->_len);
+    free(out->_buf);
+    out->_buf = buf;
+    return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: outputTuple
+ * append one "(userid,topic,weight)" line to the buffer.
+ *
+ * RETURN: 0 on success, -1 if the buffer could not be written/grown.
+ *
+ * EXAMPLE OUTPUT: "(1111,history        ,50)\n"
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int outputTuple(output_t* out, char* userid, char* topic, int32_t weight)
+{
+    if (out->_cap - out->_len < OUTPUT_MAX_LINE)
+    {
+        if (out->hold ? _outputGrow(out) : outputFlush(out))
+            return -1;
+    }
+
+    char* p = out->_buf + out->_len;
+    *p++ = LB;
+    memcpy(p, userid, LEN_USER_ID);
+    p += LEN_USER_ID;
+    *p++ = DELIMITER;
+    memcpy(p, topic, LEN_TOPIC);
+    p += LEN_TOPIC;
+    *p++ = DELIMITER;
+
+    // weight.. digits are produced backwards into a scratch buffer
+    char digits[12];
+    int n = 0;
+    uint32_t magnitude = (weight < 0) ? -(uint32_t)weight : (uint32_t)weight;
+    do
+    {
+        digits[n++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude);
+    if (weight < 0)
+        *p++ = '-';
+    while (n)
+        *p++ = digits[--n];
+
+    *p++ = RB;
+    *p++ = ENTER;
+
+    out->_len = p - out->_buf;
+    out->lines++;
+    return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: outputDict
+ * append one line per dictionary entry, in the order the topics
+ * were first seen. A NULL dictionary writes nothing.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int outputDict(output_t* out, char* userid, dict_t* dictionary)
+{
+    if (dictionary == NULL)
+        return 0;
+
+    for (uint32_t i = 0; i < dictionary->count; i++)
+    {
+        entry_t* entry = &dictionary->entries[i];
+        if (outputTuple(out, userid, entry->key.text, entry->value) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: outputFlush
+ * hand the buffered lines to the kernel with a single write(2)
+ * (more only if the kernel takes a partial write).
+ *
+ * RETURN: 0 on success, -1 on a write error.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int outputFlush(output_t* out)
+{
+    struct iovec iov;
+    int error;
+
+    if (out->_len == 0)
+        return 0;
+
+    iov.iov_base = out->_buf;
+    iov.iov_len = out->_len;
+
+    if (out->lock != NULL)
+        pthread_mutex_lock(out->lock);
+    error = _outputWritev(out->fd, &iov, 1, &out->writes);
+    if (out->lock != NULL)
+        pthread_mutex_unlock(out->lock);
+
+    out->_len = 0;
+    return error;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: outputWriteAll
+ * write the buffers of 'count' outputs to 'fd' in array order using
+ * as few writev(2) calls as possible, then empty them. Used for held
+ * outputs once every producer thread is done.
+ *
+ * RETURN: 0 on success, -1 on a write error.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int outputWriteAll(output_t* outs, int count, int fd)
+{
+    struct iovec* iov = (struct iovec*)malloc(count*sizeof(struct iovec));
+    int used = 0;
+    int error = 0;
+
+    if (iov == NULL)
+        return -1;
+
+    for (int i = 0; i < count; i++)
+    {
+        if (outs[i]._len == 0)
+            continue;
+        iov[used].iov_base = outs[i]._buf;
+        iov[used].iov_len = outs[i]._len;
+        used++;
+    }
+
+    // system calls are charged to the first output
+    if (used > 0)
+        error = _outputWritev(fd, iov, used, &outs[0].writes);
+
+    for (int i = 0; i < count; i++)
+        outs[i]._len = 0;
+
+    free(iov);
+    return error;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                        PRIVATE FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _outputWritev
+ * writev(2) every byte of 'iov', continuing after partial writes and
+ * splitting the vector at IOV_MAX entries.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static int _outputWritev(int fd, struct iovec* iov, int count, uint64_t* writes)
+{
+    while (count > 0)
+    {
+        int batch = (count < IOV_MAX) ? count : IOV_MAX;
+        ssize_t len = writev(fd, iov, batch);
+        (*writes)++;
+
+        if (len < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        // skip the vectors that were written completely
+        while (count > 0 && (size_t)len >= iov->iov_len)
+        {
+            len -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0)
+        {
+            iov->iov_base = (char*)iov->iov_base + len;
+            iov->iov_len -= len;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _outputGrow
+ * double the buffer of a held output.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static int _outputGrow(output_t* out)
+{
+    char* buf = (char*)realloc(out->_buf, out->_cap*2);
+    if (buf == NULL)
+        return -1;
+
+    out->_buf = buf;
+    out->_cap *= 2;
+    return 0;
+}
@@ -0,0 +1,61 @@
+#ifndef _OUTPUT_SRC_HEADER_
+#define _OUTPUT_SRC_HEADER_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "common.h"
+#include "dictionary.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                            DEFINES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+#define OUTPUT_BUF_SIZE     (64*1024)   // bytes formatted before a write(2)
+#define OUTPUT_MAX_LINE     48          // longest "(userid,topic,weight)\n" line
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           TYPEDEFS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+// output structure collects formatted (userid,topic,weight) lines in a
+// private buffer and hands them to the kernel with one write(2) once
+// the buffer is full. Every reducer owns one, so formatting never
+// touches a shared lock. The writers sit side by side in an array, so
+// each starts a cache line of its own.
+typedef struct outputStruct
+{
+    // public parameters
+    _Alignas(CACHE_LINE_SIZE) int fd;   // destination (STDOUT_FILENO for the console)
+    int hold;               // 1 = keep everything in memory until outputWriteAll
+    pthread_mutex_t* lock;  // optional, taken around each write(2) when outputs share fd
+    uint64_t lines;         // tuples formatted
+    uint64_t writes;        // write(2)/writev(2) calls made
+
+    // private parameters
+    char* _buf;
+    size_t _len;
+    size_t _cap;
+} output_t;
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+int output(output_t* out, int fd, int hold, pthread_mutex_t* lock);
+void outputDestruct(output_t* out);
+int outputPlace(output_t* out);
+int outputTuple(output_t* out, char* userid, char* topic, int32_t weight);
+int outputDict(output_t* out, char* userid, dict_t* dictionary);
+int outputFlush(output_t* out);
+int outputWriteAll(output_t* outs, int count, int fd);
+
+#endif
@@ -0,0 +1,314 @@
+/*
+ * SUMMARY: parser
+ * This file contains a bulk parser for the (userid,action,topic) input
+ * format. It replaces the getchar() per byte state machine that used
+ * to read tuples from the console.
+ *
+ * NOTE: The input is read PARSER_BUF_SIZE bytes at a time with read(2).
+ * Brackets and delimiters are located with memchr (vectorized in libc),
+ * so the bytes between tuples (commas, newlines) are skipped in bulk.
+ * A tuple that straddles two reads is moved to the front of the buffer
+ * before the next read.
+ *
+ * NOTE: A parser can also be limited to a byte range of a regular file
+ * (parserRange). parserSplit cuts a file into ranges that end on tuple
+ * boundaries so several parsers can read one file in parallel with
+ * pread(2) and no shared file offset.
+ */
+
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include "parser.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                            DEFINES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+// longest run of bytes from '(' to ')' that can still be a valid tuple
+#define PARSER_MAX_TUPLE    (LEN_USER_ID + LEN_ACTION + LEN_TOPIC + 4)
+
+// bytes read at a time while looking for a shard boundary
+#define PARSER_SPLIT_SCAN   4096
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+static int _parserFill(parser_t* p);
+static int _parserTuple(char* lb, char* rb, mTupleIn_t* tuple);
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: parser
+ * allocate the read buffer of a parser that reads from 'fd'.
+ *
+ * RETURN: 0 on success, -1 if the buffer cannot be allocated.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int parser(parser_t* p, int fd)
+{
+    p->fd = fd;
+    p->errors = 0;
+    p->_start = 0;
+    p->_end = 0;
+    p->_eof = 0;
+    p->_offset = 0;
+    p->_limit = -1;
+    p->_buf = (char*)malloc(PARSER_BUF_SIZE);
+    if (p->_buf == NULL)
+        return -1;
+
+    // connect functions
+    p->read = &parserRead;
+    return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: parserRange
+ * same as parser, but only the bytes [start, end) of 'fd' are read.
+ * 'fd' must be seekable. Several range parsers may share one fd.
+ *
+ * RETURN: 0 on success, -1 if the buffer cannot be allocated.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int parserRange(parser_t* p, int fd, off_t start, off_t end)
+{
+    if (parser(p, fd) == -1)
+        return -1;
+
+    p->_offset = start;
+    p->_limit = (end > start) ? end : start;
+    return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: parserSplit
+ * cuts the file behind 'fd' into 'n' byte ranges of about the same
+ * size. Range i is [bounds[i], bounds[i+1]), so 'bounds' must hold
+ * n + 1 offsets. Every inner boundary is moved forward to just after
+ * the next ')' or newline, so no tuple is split between two ranges.
+ * Ranges may be empty when the file is small.
+ *
+ * RETURN: 0 on success, -1 if the file size cannot be read.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int parserSplit(int fd, int n, off_t* bounds)
+{
+    struct stat st;
+    char scan[PARSER_SPLIT_SCAN];
+
+    if (n <= 0 || fstat(fd, &st) == -1)
+        return -1;
+
+    bounds[0] = 0;
+    bounds[n] = st.st_size;
+
+    for (int i = 1; i < n; i++)
+    {
+        off_t pos = (off_t)((double)st.st_size * i / n);
+        if (pos < bounds[i - 1])
+            pos = bounds[i - 1];
+
+        // scan forward to the end of the tuple that covers 'pos'
+        bounds[i] = st.st_size;
+        while (pos < st.st_size)
+        {
+            ssize_t len = pread(fd, scan, sizeof(scan), pos);
+            if (len <= 0)
+                break;
+
+            char* rb = (char*)memchr(scan, RB, len);
+            char* nl = (char*)memchr(scan, ENTER, len);
+            if (rb == NULL || (nl != NULL && nl < rb))
+                rb = nl;
+            if (rb != NULL)
+            {
+                bounds[i] = pos + (rb - scan) + 1;
+                break;
+            }
+            pos += len;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: parserDestruct
+ * deallocate the read buffer. The file descriptor is not closed.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void parserDestruct(parser_t* p)
+{
+    free(p->_buf);
+    p->_buf = NULL;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: parserRead -> connects to parser.read
+ * copies up to 'max' tuples into the caller's array. Only blocks on
+ * the input when no complete tuple is buffered, so a slow pipe still
+ * gets its tuples through as soon as they arrive.
+ *
+ * RETURN: number of tuples stored, 0 once the input is exhausted.
+ *
+ * EXAMPLE INPUT: "(1111,P,history),(1111,L,art)"
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int parserRead(parser_t* p, mTupleIn_t* tuples, int max)
+{
+    int count = 0;
+
+    while (count < max)
+    {
+        char* start = p->_buf + p->_start;
+        size_t avail = p->_end - p->_start;
+
+        // skip everything up to the next left bracket
+        char* lb = (char*)memchr(start, LB, avail);
+        if (lb == NULL)
+        {
+            p->_start = p->_end;
+            if (count > 0 || _parserFill(p) <= 0)
+                return count;
+            continue;
+        }
+        p->_start = lb - p->_buf;
+        avail = p->_end - p->_start;
+
+        // the right bracket must follow within one tuple's length
+        size_t window = (avail < PARSER_MAX_TUPLE + 1) ? avail : PARSER_MAX_TUPLE + 1;
+        char* rb = (char*)memchr(lb, RB, window);
+        if (rb == NULL)
+        {
+            // too long to be a tuple.. skip this bracket
+            if (avail > PARSER_MAX_TUPLE)
+            {
+                p->errors++;
+                p->_start++;
+                continue;
+            }
+
+            // incomplete tuple at the end of the buffer.. read more
+            if (count > 0)
+                return count;
+            if (_parserFill(p) <= 0)
+            {
+                if (p->_end > p->_start)
+                    p->errors++;
+                p->_start = p->_end;
+                return count;
+            }
+            continue;
+        }
+
+        if (_parserTuple(lb, rb, &tuples[count]) == 0)
+            count++;
+        else
+            p->errors++;
+
+        p->_start = rb + 1 - p->_buf;
+    }
+
+    return count;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                        PRIVATE FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _parserFill
+ * moves the unparsed bytes to the front of the buffer and reads
+ * as much input as fits behind them.
+ *
+ * RETURN: bytes read, 0 at EOF (or on a read error).
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static int _parserFill(parser_t* p)
+{
+    if (p->_eof)
+        return 0;
+
+    if (p->_start > 0)
+    {
+        memmove(p->_buf, p->_buf + p->_start, p->_end - p->_start);
+        p->_end -= p->_start;
+        p->_start = 0;
+    }
+
+    ssize_t len;
+    size_t want = PARSER_BUF_SIZE - p->_end;
+    if (p->_limit >= 0 && (off_t)want > p->_limit - p->_offset)
+        want = p->_limit - p->_offset;
+
+    do
+    {
+        if (p->_limit < 0)
+            len = read(p->fd, p->_buf + p->_end, want);
+        else
+            len = (want > 0) ? pread(p->fd, p->_buf + p->_end, want, p->_offset) : 0;
+    } while (len < 0 && errno == EINTR);
+
+    if (len <= 0)
+    {
+        p->_eof = 1;
+        return 0;
+    }
+
+    p->_end += len;
+    p->_offset += len;
+    return (int)len;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _parserTuple
+ * splits the bytes between 'lb' and 'rb' into the tuple fields. The
+ * topic is padded with spaces up to LEN_TOPIC.
+ *
+ * RETURN: 0 for valid data, -1 for error
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static int _parserTuple(char* lb, char* rb, mTupleIn_t* tuple)
+{
+    char* userid = lb + 1;
+    char* c1 = (char*)memchr(userid, DELIMITER, rb - userid);
+    if (c1 == NULL || c1 - userid > LEN_USER_ID)
+        return -1;
+
+    char* action = c1 + 1;
+    char* c2 = (char*)memchr(action, DELIMITER, rb - action);
+    if (c2 == NULL || c2 - action != LEN_ACTION)
+        return -1;
+
+    char* topic = c2 + 1;
+    if (rb - topic > LEN_TOPIC)
+        return -1;
+
+    memset(tuple->userid, SPACE, LEN_USER_ID);
+    memcpy(tuple->userid, userid, c1 - userid);
+    tuple->action = *action;
+    memset(tuple->topic, SPACE, LEN_TOPIC);
+    memcpy(tuple->topic, topic, rb - topic);
+    tuple->error = 0;
+    return 0;
+}
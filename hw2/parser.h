@@ -0,0 +1,59 @@
+#ifndef _PARSER_SRC_HEADER_
+#define _PARSER_SRC_HEADER_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include "common.h"
+#include "mapper.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                            DEFINES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+#define PARSER_BUF_SIZE     (1 << 20)   // bytes read from the input per read(2)
+#define PARSER_BATCH_SIZE   256         // tuples a caller typically asks for at once
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           TYPEDEFS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+// parser structure reads the input in large blocks and cuts complete
+// (userid,action,topic) tuples out of the block with memchr.
+typedef struct parserStruct
+{
+    // public parameters
+    int fd;                 // input file descriptor (STDIN_FILENO for the console)
+    uint64_t errors;        // malformed tuples that were skipped
+
+    // functions
+    int (*read)(struct parserStruct* p, mTupleIn_t* tuples, int max); // fills up to max tuples
+
+    // private parameters
+    char* _buf;
+    size_t _start;          // first byte not parsed yet
+    size_t _end;            // end of the valid bytes in _buf
+    int _eof;
+    off_t _offset;          // next file offset to read (ranges only)
+    off_t _limit;           // end of the range, -1 to read the fd to EOF
+} parser_t;
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+int parser(parser_t* p, int fd);
+int parserRange(parser_t* p, int fd, off_t start, off_t end);
+int parserSplit(int fd, int n, off_t* bounds);
+void parserDestruct(parser_t* p);
+int parserRead(parser_t* p, mTupleIn_t* tuples, int max);
+
+#endif
@@ -0,0 +1,159 @@
+/*
+ * SUMMARY: parserBench.c
+ * Input parsing throughput of the bulk parser versus the getchar()
+ * state machine the mapper used before (with stdin buffering turned
+ * off, as the combiner ran it). Both parse the same generated file of
+ * (userid,action,topic) tuples.
+ *
+ * USAGE: ./parserBench [numTuples]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "mapper.h"
+#include "parser.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           DEFINES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+#define DEFAULT_NUM_TUPLES  1000000
+#define BENCH_SEED          5733
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+static double elapsedSeconds(struct timespec* start, struct timespec* end)
+{
+  return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: charRead
+ * the old per character reader, condensed: skip to '(', then fill
+ * the user id, action and topic one getc() at a time.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static int charRead(FILE* in, mTupleIn_t* tuple)
+{
+  int c;
+  int field = -1;
+  int count = 0;
+
+  while ((c = getc(in)) != EOF)
+  {
+    if (field < 0)
+    {
+      if (c == LB)
+        field = 0;
+    }
+    else if (c == RB && field == 2)
+    {
+      for (; count < LEN_TOPIC; count++)
+        tuple->topic[count] = SPACE;
+      return 0;
+    }
+    else if (c == DELIMITER && field < 2)
+    {
+      field++;
+      count = 0;
+    }
+    else if (field == 0 && count < LEN_USER_ID)
+      tuple->userid[count++] = c;
+    else if (field == 1 && count < LEN_ACTION)
+      tuple->action = c, count++;
+    else if (field == 2 && count < LEN_TOPIC)
+      tuple->topic[count++] = c;
+  }
+
+  return -1;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                              MAIN
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+int main(int argc, char **argv)
+{
+  long numTuples = (argc > 1) ? atol(argv[1]) : DEFAULT_NUM_TUPLES;
+  const char* topics[] = {"history", "art", "cosmetics", "entertainment", "sports", "photography"};
+  struct timespec start, end;
+  mTupleIn_t tuples[PARSER_BATCH_SIZE];
+
+  if (numTuples <= 0)
+  {
+    printf("ERROR: Expecting ./parserBench [numTuples]\n");
+    return -1;
+  }
+
+  // generate the input in the same one-line format as input.txt
+  FILE* file = tmpfile();
+  srand(BENCH_SEED);
+  for (long i = 0; i < numTuples; i++)
+  {
+    fprintf(file, "%s(%04d,%c,%-15s)", i ? "," : "", (int)(i / 8) % 10000,
+            RULE_ACTION[rand() % MAPPING_COUNT], topics[rand() % 6]);
+  }
+  fprintf(file, "\n");
+  fflush(file);
+  double megabytes = ftell(file) / 1e6;
+
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  // getc() state machine, unbuffered
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  rewind(file);
+  setbuf(file, NULL);
+  long charCount = 0;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  while (charRead(file, &tuples[0]) == 0)
+    charCount++;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double charTime = elapsedSeconds(&start, &end);
+
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  // bulk parser
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  parser_t input;
+  lseek(fileno(file), 0, SEEK_SET);
+  parser(&input, fileno(file));
+  long bulkCount = 0;
+  int n;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  while ((n = input.read(&input, tuples, PARSER_BATCH_SIZE)) > 0)
+    bulkCount += n;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double bulkTime = elapsedSeconds(&start, &end);
+  parserDestruct(&input);
+  fclose(file);
+
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  // report
+  // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+  printf("tuples=%ld size=%.1fMB\n", numTuples, megabytes);
+  printf("%-8s %10s %12s\n", "parser", "MB/s", "tuples");
+  printf("%-8s %10.1f %12ld\n", "getc", megabytes / charTime, charCount);
+  printf("%-8s %10.1f %12ld\n", "bulk", megabytes / bulkTime, bulkCount);
+  printf("speedup  %9.1fx\n", charTime / bulkTime);
+
+  if (charCount != numTuples || bulkCount != numTuples)
+  {
+    printf("ERROR: Tuple counts do not match.\n");
+    return -1;
+  }
+
+  return 0;
+}
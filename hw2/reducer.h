@@ -7,6 +7,7 @@
 #include <stdlib.h>
 #include "common.h"
 #include "dictionary.h"
+#include "output.h"
 
 #define REDUCER_DEBUG_MODE 0
 
@@ -24,9 +25,6 @@ typedef struct rTupleIn
     char topic[15];     // TOPIC - Pad this with space if unused.
     int32_t weight;     // WEIGHT - Value mapped from the input action as defined by the set of rules in 'main' summary.
 
-    struct rTupleIn* next; // FIFO implementation in channel.c
-    struct rTupleIn* prev; // FIFO implementation in channel.c
-
 } rTupleIn_t;
 
 typedef enum state
@@ -45,8 +43,8 @@ typedef enum state
  */
 
 int32_t r_console_tuple_read(rTupleIn_t * tuple);
-void r_console_tuple_write(char* userId, node_t * dictionary);
-void reduce(node_t * dictionary, rTupleIn_t * in);
+void r_console_tuple_write(output_t* out, char* userId, dict_t * dictionary);
+void reduce(dict_t * dictionary, rTupleIn_t * in);
 int32_t compareUserId(char* a, char* b);
 void copyUserId(char* copy, char* orig);
 
@@ -5,4 +5,8 @@ find . -name "mapper" -type f -delete
 find . -name "combiner" -type f -delete
 find . -name "test.txt" -type f -delete
 find . -name "test_input.txt" -type f -delete
-find . -name "test_output.txt" -type f -delete
\ No newline at end of file
+find . -name "test_output.txt" -type f -delete
+find . -name "dictBench" -type f -delete
+find . -name "channelBench" -type f -delete
+find . -name "routerBench" -type f -delete
+find . -name "parserBench" -type f -delete
\ No newline at end of file
@@ -0,0 +1,288 @@
+/*
+ * SUMMARY: router
+ * This file contains functions to assign user ids to channels. It
+ * replaces the mapper's linear scan of every channel's user id with
+ * an open addressing table keyed by the packed 4 byte user id.
+ *
+ * NOTE: The policy is only consulted the first time a user id is
+ * seen. After that the user map answers, so every tuple of a user
+ * goes to the same reducer regardless of the policy.
+ */
+
+#include "router.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+static uint32_t _routerMix(uint32_t x);
+static int _routerAssign(router_t* r, user_key_t key);
+static int _routerRingLookup(router_t* r, uint32_t hash);
+static int _routerComparePoints(const void* a, const void* b);
+static int _routerGrow(router_t* r);
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: router
+ * allocate the user map + load counters (and the hash ring for
+ * E_ROUTE_HASH) for the selected router.
+ *
+ * NOTE: Returns -1 if the router cannot be allocated.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+int router(router_t* r, int numChannels, route_policy_t policy)
+{
+  if (numChannels <= 0)
+    return -1;
+
+  r->policy = policy;
+  r->numChannels = numChannels;
+  r->numUsers = 0;
+  r->_nextChannel = 0;
+  r->_ring = NULL;
+  r->_ringSize = 0;
+
+  r->_mask = ROUTER_INIT_CAPACITY - 1;
+  r->_slots = (route_slot_t*)malloc(ROUTER_INIT_CAPACITY*sizeof(route_slot_t));
+  r->_load = (uint64_t*)calloc(numChannels, sizeof(uint64_t));
+  if (r->_slots == NULL || r->_load == NULL)
+    return -1;
+
+  for (uint32_t i = 0; i <= r->_mask; i++)
+    r->_slots[i].channel = ROUTER_EMPTY;
+
+  // place ROUTER_VNODES points per channel on the ring so that adding
+  // or removing a reducer only moves ~1/numChannels of the users.
+  if (policy == E_ROUTE_HASH)
+  {
+    r->_ringSize = numChannels*ROUTER_VNODES;
+    r->_ring = (route_point_t*)malloc(r->_ringSize*sizeof(route_point_t));
+    if (r->_ring == NULL)
+      return -1;
+
+    for (int ch = 0; ch < numChannels; ch++)
+    {
+      for (int v = 0; v < ROUTER_VNODES; v++)
+      {
+        route_point_t* p = &r->_ring[ch*ROUTER_VNODES + v];
+        p->hash = _routerMix(((uint32_t)ch << 16) ^ (uint32_t)v ^ 0x9e3779b9u);
+        p->channel = ch;
+      }
+    }
+    qsort(r->_ring, r->_ringSize, sizeof(route_point_t), _routerComparePoints);
+  }
+
+  // connect functions
+  r->route = &routerRoute;
+  return 0;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: routerDestruct
+ * deallocate the user map, hash ring and load counters.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+void routerDestruct(router_t* r)
+{
+  free(r->_slots);
+  free(r->_ring);
+  free(r->_load);
+  r->_slots = NULL;
+  r->_ring = NULL;
+  r->_load = NULL;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: routerRoute -> connects to router.route
+ * returns the channel number that the tuples of 'userid' (LEN_USER_ID
+ * characters, not null terminated) must be written to.
+ *
+ * NOTE: Returns -1 if a new user could not be added to the map.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+int routerRoute(router_t* r, char* userid)
+{
+  user_key_t key = userKey(userid);
+
+  uint32_t i = _routerMix(key) & r->_mask;
+  while (r->_slots[i].channel != ROUTER_EMPTY)
+  {
+    if (r->_slots[i].userid == key)
+    {
+      r->_load[r->_slots[i].channel]++;
+      return r->_slots[i].channel;
+    }
+    i = (i + 1) & r->_mask;
+  }
+
+  // first time this user is seen.. keep the load factor under 3/4.
+  if ((uint32_t)(r->numUsers + 1)*4 > (r->_mask + 1)*3)
+  {
+    if (_routerGrow(r) < 0)
+      return -1;
+
+    i = _routerMix(key) & r->_mask;
+    while (r->_slots[i].channel != ROUTER_EMPTY)
+      i = (i + 1) & r->_mask;
+  }
+
+  int channel = _routerAssign(r, key);
+  r->_slots[i].userid = key;
+  r->_slots[i].channel = channel;
+  r->numUsers++;
+  r->_load[channel]++;
+  return channel;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: routerParsePolicy
+ * converts a policy name from the command line ("sticky", "hash"
+ * or "least") into a route_policy_t.
+ *
+ * NOTE: Returns -1 if the name is not recognized.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+int routerParsePolicy(char* name)
+{
+  if (strcmp(name, "sticky") == 0)
+    return E_ROUTE_STICKY;
+  else if (strcmp(name, "hash") == 0)
+    return E_ROUTE_HASH;
+  else if (strcmp(name, "least") == 0)
+    return E_ROUTE_LEAST;
+  return -1;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      PRIVATE FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: _routerMix
+ * murmur3 finalizer. User ids are ASCII digits, so the packed key
+ * needs its bits spread before it is masked into a table index.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+static uint32_t _routerMix(uint32_t x)
+{
+  x ^= x >> 16;
+  x *= 0x85ebca6bu;
+  x ^= x >> 13;
+  x *= 0xc2b2ae35u;
+  x ^= x >> 16;
+  return x;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: _routerAssign
+ * picks the channel for a user id that has not been seen before.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+static int _routerAssign(router_t* r, user_key_t key)
+{
+  int channel = 0;
+
+  switch (r->policy)
+  {
+    case E_ROUTE_HASH:
+      channel = _routerRingLookup(r, _routerMix(key));
+      break;
+
+    case E_ROUTE_LEAST:
+      for (int i = 1; i < r->numChannels; i++)
+      {
+        if (r->_load[i] < r->_load[channel])
+          channel = i;
+      }
+      break;
+
+    default:
+      channel = r->_nextChannel;
+      r->_nextChannel = (r->_nextChannel + 1) % r->numChannels;
+      break;
+  }
+
+  return channel;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: _routerRingLookup
+ * binary search for the first ring point at or after 'hash',
+ * wrapping around to the first point.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+static int _routerRingLookup(router_t* r, uint32_t hash)
+{
+  int lo = 0;
+  int hi = r->_ringSize;
+
+  while (lo < hi)
+  {
+    int mid = lo + (hi - lo)/2;
+    if (r->_ring[mid].hash < hash)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  if (lo == r->_ringSize)
+    lo = 0;
+  return r->_ring[lo].channel;
+}
+
+static int _routerComparePoints(const void* a, const void* b)
+{
+  uint32_t ha = ((const route_point_t*)a)->hash;
+  uint32_t hb = ((const route_point_t*)b)->hash;
+  return (ha > hb) - (ha < hb);
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: _routerGrow
+ * doubles the user map and re-inserts every user. Users are only
+ * added once each, so the full rehash is rare.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+static int _routerGrow(router_t* r)
+{
+  uint32_t newMask = (r->_mask << 1) | 1;
+  route_slot_t* slots = (route_slot_t*)malloc((newMask + 1)*sizeof(route_slot_t));
+  if (slots == NULL)
+    return -1;
+
+  for (uint32_t i = 0; i <= newMask; i++)
+    slots[i].channel = ROUTER_EMPTY;
+
+  for (uint32_t i = 0; i <= r->_mask; i++)
+  {
+    if (r->_slots[i].channel == ROUTER_EMPTY)
+      continue;
+
+    uint32_t j = _routerMix(r->_slots[i].userid) & newMask;
+    while (slots[j].channel != ROUTER_EMPTY)
+      j = (j + 1) & newMask;
+    slots[j] = r->_slots[i];
+  }
+
+  free(r->_slots);
+  r->_slots = slots;
+  r->_mask = newMask;
+  return 0;
+}
@@ -0,0 +1,82 @@
+#ifndef _ROUTER_SRC_HEADER_
+#define _ROUTER_SRC_HEADER_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "common.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      DEFINES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+#define ROUTER_INIT_CAPACITY  64  // initial number of user map slots (power of 2)
+#define ROUTER_VNODES         64  // points per channel on the consistent hash ring
+#define ROUTER_EMPTY          -1  // marks an unused user map slot
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      TYPEDEFS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+// how a user id seen for the first time is assigned to a channel
+typedef enum routePolicy
+{
+  E_ROUTE_STICKY,   // next channel round-robin, like the original mapper
+  E_ROUTE_HASH,     // consistent hashing over ROUTER_VNODES points per channel
+  E_ROUTE_LEAST     // channel that has been routed the fewest tuples so far
+} route_policy_t;
+
+// one user id -> channel slot of the open addressing user map
+typedef struct routeSlot
+{
+  user_key_t userid;  // the 4 user id characters packed into one word
+  int32_t channel;    // ROUTER_EMPTY if the slot is unused
+} route_slot_t;
+
+// one point of the consistent hash ring
+typedef struct routePoint
+{
+  uint32_t hash;
+  int32_t channel;
+} route_point_t;
+
+// router structure maps a user id to a channel in O(1). Every user
+// is assigned once, on first sight, using the selected policy and
+// keeps that channel afterwards so its tuples stay in order.
+typedef struct routerStruct
+{
+  // public parameters
+  route_policy_t policy;
+  int numChannels;
+  int numUsers;     // distinct user ids routed so far
+
+  // functions
+  int (*route)(struct routerStruct* r, char* userid); // returns the channel for the user id
+
+  // private parameters
+  route_slot_t* _slots;   // linear probe user map
+  uint32_t _mask;
+  int _nextChannel;       // sticky policy cursor
+  route_point_t* _ring;   // sorted consistent hash ring
+  int _ringSize;
+  uint64_t* _load;        // tuples routed per channel
+
+} router_t;
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+int router(router_t* r, int numChannels, route_policy_t policy);
+void routerDestruct(router_t* r);
+int routerRoute(router_t* r, char* userid);
+int routerParsePolicy(char* name);
+
+#endif
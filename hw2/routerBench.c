@@ -0,0 +1,155 @@
+/*
+ * SUMMARY: routerBench.c
+ * Microbenchmark comparing the router's user map against the linear
+ * scan over every channel's user id that the mapper used before. Users
+ * arrive interleaved (random order) and the time per lookup is reported
+ * for each routing policy.
+ *
+ * USAGE: ./routerBench [numUsers] [numOps]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "common.h"
+#include "router.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           DEFINES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+#define DEFAULT_NUM_USERS   1000
+#define DEFAULT_NUM_OPS     2000000
+#define BENCH_SEED          5733
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+static double elapsedSeconds(struct timespec* start, struct timespec* end)
+{
+  return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: linearRoute
+ * the original mapper lookup: strncmp every used channel's user id
+ * and claim the next free channel for a new user. Users beyond the
+ * channel count share the last channel, as before.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static int linearRoute(char (*channelIds)[LEN_USER_ID], int numChannels, int* maxChannelNum, char* userid)
+{
+  int i;
+  for (i = 0; i < numChannels; i++)
+  {
+    if (strncmp(userid, channelIds[i], LEN_USER_ID) == 0)
+      return i;
+
+    if (i > *maxChannelNum)
+    {
+      *maxChannelNum = i;
+      memcpy(channelIds[i], userid, LEN_USER_ID);
+      return i;
+    }
+  }
+  return numChannels - 1;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                              MAIN
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+int main(int argc, char **argv)
+{
+  int numUsers = (argc > 1) ? atoi(argv[1]) : DEFAULT_NUM_USERS;
+  int numOps = (argc > 2) ? atoi(argv[2]) : DEFAULT_NUM_OPS;
+  const int channels[] = {8, 128, 512};
+  const char* policyName[] = {"sticky", "hash", "least"};
+  struct timespec start, end;
+
+  if (numUsers <= 0 || numOps <= 0)
+  {
+    printf("ERROR: Expecting ./routerBench [numUsers] [numOps]\n");
+    return -1;
+  }
+
+  // 4 digit user ids, interleaved in a random order
+  char (*users)[LEN_USER_ID] = malloc(numUsers * LEN_USER_ID);
+  for (int i = 0; i < numUsers; i++)
+  {
+    char temp[LEN_USER_ID + 1];
+    snprintf(temp, sizeof(temp), "%04d", i % 10000);
+    memcpy(users[i], temp, LEN_USER_ID);
+  }
+
+  int* sequence = malloc(numOps * sizeof(int));
+  srand(BENCH_SEED);
+  for (int i = 0; i < numOps; i++)
+    sequence[i] = rand() % numUsers;
+
+  printf("users=%d ops=%d\n", numUsers, numOps);
+  printf("%-9s %-8s %10s %12s\n", "channels", "router", "ns/op", "max/avg load");
+
+  for (int c = 0; c < (int)(sizeof(channels)/sizeof(channels[0])); c++)
+  {
+    int numChannels = channels[c];
+    long sink = 0;
+
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    // linear scan
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    char (*channelIds)[LEN_USER_ID] = calloc(numChannels, LEN_USER_ID);
+    int maxChannelNum = -1;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < numOps; i++)
+      sink += linearRoute(channelIds, numChannels, &maxChannelNum, users[sequence[i]]);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("%-9d %-8s %10.1f %12s\n", numChannels, "linear", elapsedSeconds(&start, &end) * 1e9 / numOps, "-");
+    free(channelIds);
+
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    // router policies
+    // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+    for (int p = E_ROUTE_STICKY; p <= E_ROUTE_LEAST; p++)
+    {
+      router_t rt;
+      router(&rt, numChannels, (route_policy_t)p);
+
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      for (int i = 0; i < numOps; i++)
+        sink += rt.route(&rt, users[sequence[i]]);
+      clock_gettime(CLOCK_MONOTONIC, &end);
+
+      // how evenly the tuples were spread over the channels
+      uint64_t maxLoad = 0;
+      for (int i = 0; i < numChannels; i++)
+      {
+        if (rt._load[i] > maxLoad)
+          maxLoad = rt._load[i];
+      }
+
+      printf("%-9d %-8s %10.1f %12.2f\n", numChannels, policyName[p],
+             elapsedSeconds(&start, &end) * 1e9 / numOps,
+             maxLoad / ((double)numOps / numChannels));
+      routerDestruct(&rt);
+    }
+
+    if (sink == 0)
+      printf("\n");
+  }
+
+  free(sequence);
+  free(users);
+  return 0;
+}
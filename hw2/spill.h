@@ -0,0 +1,81 @@
+#ifndef _SPILL_SRC_HEADER_
+#define _SPILL_SRC_HEADER_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "common.h"
+#include "dictionary.h"
+#include "output.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                            DEFINES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+#define SPILL_DEFAULT_MB    64      // default memory budget (-M) in megabytes
+#define SPILL_INIT_USERS    64      // initial size of the user table
+#define SPILL_READ_BATCH    256     // records read from a run at a time while merging
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           TYPEDEFS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+// One partial aggregate in the spill file. Runs are written user by
+// user in user id order, topics in the order they were first seen.
+typedef struct __attribute__((packed)) spillRecord
+{
+    char userid[LEN_USER_ID];
+    char topic[LEN_TOPIC];
+    int32_t weight;
+} spill_record_t;
+
+typedef struct spillUser
+{
+    char userid[LEN_USER_ID];
+    dict_t* dictionary;
+} spill_user_t;
+
+// spill structure reduces tuples of any user in any order. Every user
+// has its own dictionary, found through a table keyed by user id. Once
+// the dictionaries hold more than 'budget' bytes, all of them are
+// written to a temp file as one sorted run and freed. At EOF the runs
+// are merged per user and each user is written exactly once.
+typedef struct spillStruct
+{
+    // public parameters
+    size_t budget;          // bytes of aggregation state before a spill
+    size_t peak;            // most bytes held at once
+    uint64_t runs;          // runs written to the temp file
+    uint64_t records;       // records written to the temp file
+
+    // functions
+    int (*add)(struct spillStruct* s, char* userid, char* topic, int32_t weight); // reduce one tuple
+    int (*write)(struct spillStruct* s, output_t* out);                        // merge and write all users
+
+    // private parameters
+    dict_t* _index;         // space padded user id -> slot in _users
+    spill_user_t* _users;
+    uint32_t _numUsers;
+    uint32_t _capUsers;
+    size_t _bytes;          // bytes held by _index, _users and the dictionaries
+    FILE* _file;            // spilled runs, NULL until the first spill
+    long* _runEnd;          // file offset where each run ends
+} spill_t;
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+int spill(spill_t* s, size_t budget);
+void spillDestruct(spill_t* s);
+int spillAdd(spill_t* s, char* userid, char* topic, int32_t weight);
+int spillWrite(spill_t* s, output_t* out);
+
+#endif
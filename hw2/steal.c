@@ -0,0 +1,443 @@
+/*
+ * SUMMARY: steal
+ * This file schedules the reducer threads' work as sub-batch tasks
+ * that idle reducers can steal from busy ones.
+ *
+ * NOTE: Every user is routed to one channel, so with skewed input one
+ * reducer gets most of the tuples while the others sleep on empty
+ * channels. Here a reducer cuts what it reads into tasks of at most
+ * STEAL_TASK_SIZE tuples and queues them on its own deque. The owner
+ * and idle reducers alike take the oldest task of a deque. A stolen
+ * task is reduced into one run (partial result) per user it holds.
+ *
+ * NOTE: Only the owner writes a task's runs, in channel order. A run
+ * of the same user as the last one written is added to it instead of
+ * being written, so a user split over several tasks (and threads) is
+ * still written once, with the topics in the order they were seen.
+ * When the owner runs its oldest pending task it skips the runs and
+ * reduces the tuples straight into its output, like reducer() does, so
+ * a reducer that keeps up with its channel pays nothing for stealing.
+ *
+ * NOTE: A worker has at most STEAL_MAX_PENDING tasks that are queued,
+ * running or waiting to be written. It stops reading its channel when
+ * that many are pending, which holds back its mapper like a full ring.
+ */
+
+#include "steal.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+static steal_task_t* _stealTake(steal_worker_t* w);
+static void _stealReduce(steal_task_t* task);
+static void _stealReduceInOrder(merge_run_t* carry, steal_task_t* task, output_t* out);
+static void _stealAppend(merge_run_t* carry, merge_run_t* run, output_t* out);
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: steal
+ * initialize a scheduler with one empty deque per worker.
+ *
+ * NOTE: Returns -1 if the workers cannot be allocated.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+int steal(steal_t* s, int numWorkers)
+{
+  if (numWorkers <= 0)
+    return -1;
+
+  // workers are cache line aligned so the deque locks don't share lines
+  if (posix_memalign((void**)&s->_workers, CACHE_LINE_SIZE, numWorkers*sizeof(steal_worker_t)) != 0)
+    return -1;
+  memset(s->_workers, 0, numWorkers*sizeof(steal_worker_t));
+
+  for (int i = 0; i < numWorkers; i++)
+    pthread_mutex_init(&s->_workers[i]._mutex, NULL);
+
+  s->numWorkers = numWorkers;
+  channelBell(&s->bell);
+  atomic_init(&s->_queued, 0);
+  atomic_init(&s->_open, numWorkers);
+
+  // connect functions
+  s->push = &stealPush;
+  s->room = &stealRoom;
+  s->run = &stealRun;
+  s->write = &stealWrite;
+  s->ready = &stealReady;
+  s->close = &stealClose;
+  s->finish = &stealFinish;
+  return 0;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: stealDestruct
+ * free the workers and any task that was never written.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+void stealDestruct(steal_t* s)
+{
+  for (int i = 0; i < s->numWorkers; i++)
+  {
+    steal_worker_t* w = &s->_workers[i];
+    while (w->_first != NULL)
+    {
+      steal_task_t* task = w->_first;
+      w->_first = task->next;
+      for (int r = 0; r < task->numRuns; r++)
+        dictFreeNodes(task->runs[r].dictionary);
+      free(task);
+    }
+    dictFreeNodes(w->_carry.dictionary);
+    pthread_mutex_destroy(&w->_mutex);
+  }
+
+  channelBellDestruct(&s->bell);
+  free(s->_workers);
+  s->_workers = NULL;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: stealPush -> connects to steal.push
+ * cut 'n' tuples read by 'worker' into tasks and queue them on its
+ * deque. The caller keeps 'n' within stealRoom.
+ *
+ * NOTE: Returns -1 if a task cannot be allocated.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+int stealPush(steal_t* s, int worker, mTupleOut_t* tuples, int n)
+{
+  steal_worker_t* w = &s->_workers[worker];
+  int queued = 0;
+  int error = 0;
+
+  for (int start = 0; start < n; start += STEAL_TASK_SIZE)
+  {
+    int count = (n - start < STEAL_TASK_SIZE) ? n - start : STEAL_TASK_SIZE;
+
+    // tuples and runs share the task's allocation
+    steal_task_t* task = (steal_task_t*)malloc(sizeof(steal_task_t) +
+                                               count*(sizeof(mTupleOut_t) + sizeof(merge_run_t)));
+    if (task == NULL)
+    {
+      error = -1;
+      break;
+    }
+
+    task->next = NULL;
+    atomic_init(&task->done, 0);
+    task->count = count;
+    task->numRuns = 0;
+    task->runs = (merge_run_t*)&task->tuples[count];
+    memcpy(task->tuples, &tuples[start], count*sizeof(mTupleOut_t));
+
+    // the pending list keeps channel order for stealWrite
+    if (w->_last != NULL)
+      w->_last->next = task;
+    else
+      w->_first = task;
+    w->_last = task;
+    w->_pending++;
+    w->_tasks++;
+
+    pthread_mutex_lock(&w->_mutex);
+    w->_deque[(w->_top + w->_size) % STEAL_MAX_PENDING] = task;
+    w->_size++;
+    pthread_mutex_unlock(&w->_mutex);
+    queued++;
+  }
+
+  // let the idle workers know there is something to steal
+  atomic_fetch_add(&s->_queued, queued);
+  channelBellRing(&s->bell);
+
+  return error;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: stealRoom -> connects to steal.room
+ * returns how many more tuples 'worker' can queue.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+int stealRoom(steal_t* s, int worker)
+{
+  return (STEAL_MAX_PENDING - s->_workers[worker]._pending)*STEAL_TASK_SIZE;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: stealRun -> connects to steal.run
+ * reduce one task: the oldest of the worker's own deque, otherwise
+ * the oldest of the first other deque that has one. 'out' is the
+ * worker's own output.
+ *
+ * NOTE: Returns 1 if a task was reduced, 0 if there was none.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+int stealRun(steal_t* s, int worker, output_t* out)
+{
+  if (atomic_load(&s->_queued) == 0)
+    return 0;
+
+  steal_worker_t* w = &s->_workers[worker];
+  steal_task_t* task = _stealTake(w);
+  int stolen = 0;
+
+  for (int i = 1; task == NULL && i < s->numWorkers; i++)
+  {
+    task = _stealTake(&s->_workers[(worker + i) % s->numWorkers]);
+    stolen = 1;
+  }
+  if (task == NULL)
+    return 0;
+
+  atomic_fetch_sub(&s->_queued, 1);
+
+  // every earlier task of the owner is written.. no runs needed
+  if (!stolen && task == w->_first)
+    _stealReduceInOrder(&w->_carry, task, out);
+  else
+    _stealReduce(task);
+  atomic_store_explicit(&task->done, 1, memory_order_release);
+
+  // the owner may be asleep waiting for this task
+  if (stolen)
+  {
+    w->_stolen++;
+    channelBellRing(&s->bell);
+  }
+  return 1;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: stealWrite -> connects to steal.write
+ * writes the runs of the worker's finished tasks to 'out', oldest
+ * task first, up to the first task that is not done yet. The last
+ * user is held back in case the next task continues it.
+ *
+ * NOTE: Returns the number of tasks still pending.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+int stealWrite(steal_t* s, int worker, output_t* out)
+{
+  steal_worker_t* w = &s->_workers[worker];
+
+  while (w->_first != NULL && atomic_load_explicit(&w->_first->done, memory_order_acquire))
+  {
+    steal_task_t* task = w->_first;
+    for (int r = 0; r < task->numRuns; r++)
+      _stealAppend(&w->_carry, &task->runs[r], out);
+
+    w->_first = task->next;
+    if (w->_first == NULL)
+      w->_last = NULL;
+    w->_pending--;
+    free(task);
+  }
+
+  return w->_pending;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: stealReady -> connects to steal.ready
+ * returns 1 if 'worker' has something to do besides reading its
+ * channel: a queued task anywhere, its oldest task finished, or
+ * every worker done.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+int stealReady(steal_t* s, int worker)
+{
+  steal_worker_t* w = &s->_workers[worker];
+
+  if (atomic_load(&s->_queued) > 0)
+    return 1;
+  if (w->_first != NULL && atomic_load_explicit(&w->_first->done, memory_order_acquire))
+    return 1;
+  return w->_pending == 0 && stealDone(s);
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: stealClose -> connects to steal.close
+ * one worker's channel is closed and every tuple was queued.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+void stealClose(steal_t* s)
+{
+  atomic_fetch_sub(&s->_open, 1);
+  channelBellRing(&s->bell);
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: stealFinish -> connects to steal.finish
+ * writes the user held back by stealWrite. Called once the worker
+ * has no pending tasks left.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+void stealFinish(steal_t* s, int worker, output_t* out)
+{
+  merge_run_t* carry = &s->_workers[worker]._carry;
+
+  if (carry->dictionary != NULL)
+    r_console_tuple_write(out, carry->userid, carry->dictionary);
+  dictFreeNodes(carry->dictionary);
+  carry->dictionary = NULL;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: stealDone
+ * returns 1 once every channel is drained and no task is queued.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+int stealDone(steal_t* s)
+{
+  return atomic_load(&s->_open) == 0 && atomic_load(&s->_queued) == 0;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ * SUMMARY: stealStats
+ * adds up the task counters of every worker. Only exact once the
+ * workers are done.
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+void stealStats(steal_t* s, steal_stats_t* stats)
+{
+  stats->tasks = 0;
+  stats->stolen = 0;
+  for (int i = 0; i < s->numWorkers; i++)
+  {
+    stats->tasks += s->_workers[i]._tasks;
+    stats->stolen += s->_workers[i]._stolen;
+  }
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      PRIVATE FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+// oldest queued task of a deque
+static steal_task_t* _stealTake(steal_worker_t* w)
+{
+  steal_task_t* task = NULL;
+
+  pthread_mutex_lock(&w->_mutex);
+  if (w->_size > 0)
+  {
+    task = w->_deque[w->_top];
+    w->_top = (w->_top + 1) % STEAL_MAX_PENDING;
+    w->_size--;
+  }
+  pthread_mutex_unlock(&w->_mutex);
+  return task;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _stealReduce
+ * reduce the task's tuples into one run per user, starting a new
+ * run whenever the user id changes.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static void _stealReduce(steal_task_t* task)
+{
+  merge_run_t* run = NULL;
+
+  for (int t = 0; t < task->count; t++)
+  {
+    rTupleIn_t* tuple = (rTupleIn_t*)&task->tuples[t];
+
+    if (run == NULL || compareUserId(run->userid, tuple->userid) == -1)
+    {
+      run = &task->runs[task->numRuns++];
+      copyUserId(run->userid, tuple->userid);
+      if ((run->dictionary = dict()) == NULL)
+      {
+        printf("ERROR: Out of memory in reducer.\n");
+        task->numRuns--;
+        run = NULL;
+        continue;
+      }
+    }
+
+    reduce(run->dictionary, tuple);
+  }
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _stealReduceInOrder
+ * reduce the owner's oldest pending task straight into the held
+ * back user, writing each user to 'out' as the user id changes.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static void _stealReduceInOrder(merge_run_t* carry, steal_task_t* task, output_t* out)
+{
+  for (int t = 0; t < task->count; t++)
+  {
+    rTupleIn_t* tuple = (rTupleIn_t*)&task->tuples[t];
+
+    if (carry->dictionary == NULL || compareUserId(carry->userid, tuple->userid) == -1)
+    {
+      if (carry->dictionary != NULL)
+      {
+        r_console_tuple_write(out, carry->userid, carry->dictionary);
+        dictFreeNodes(carry->dictionary);
+      }
+      copyUserId(carry->userid, tuple->userid);
+      if ((carry->dictionary = dict()) == NULL)
+      {
+        printf("ERROR: Out of memory in reducer.\n");
+        continue;
+      }
+    }
+
+    reduce(carry->dictionary, tuple);
+  }
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _stealAppend
+ * adds 'run' to the held back user if it is the same user.
+ * Otherwise the held back user is written to 'out' and 'run'
+ * is held back instead.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static void _stealAppend(merge_run_t* carry, merge_run_t* run, output_t* out)
+{
+  if (carry->dictionary != NULL && compareUserId(carry->userid, run->userid) == 0)
+  {
+    // later topics keep their place behind the ones already seen
+    dict_t* d = run->dictionary;
+    for (uint32_t e = 0; e < d->count; e++)
+      dictAddToValue(carry->dictionary, d->entries[e].key.text, d->entries[e].value);
+    dictFreeNodes(d);
+    return;
+  }
+
+  if (carry->dictionary != NULL)
+  {
+    r_console_tuple_write(out, carry->userid, carry->dictionary);
+    dictFreeNodes(carry->dictionary);
+  }
+  *carry = *run;
+}
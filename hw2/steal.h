@@ -0,0 +1,112 @@
+#ifndef _STEAL_SRC_HEADER_
+#define _STEAL_SRC_HEADER_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "mapper.h"
+#include "merge.h"
+#include "channel.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      DEFINES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+#define STEAL_TASK_SIZE     1024  // max tuples in one task (sub-batch)
+#define STEAL_MAX_PENDING   64    // tasks a worker can have in flight
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      TYPEDEFS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+// counters reported by stealStats
+typedef struct stealStats
+{
+  uint64_t tasks;         // sub-batches queued
+  uint64_t stolen;        // sub-batches reduced by a thread other than their owner
+} steal_stats_t;
+
+// A task is a sub-batch of one worker's channel, in channel order. It
+// is reduced into one run (partial dictionary) per user it contains.
+typedef struct stealTask
+{
+  struct stealTask* next; // owner's pending list, in channel order
+  atomic_int done;        // set once 'runs' are complete
+  int count;              // tuples in the sub-batch
+  int numRuns;
+  merge_run_t* runs;      // room for 'count' runs, after the tuples
+  mTupleOut_t tuples[];
+} steal_task_t;
+
+// one worker per reducer thread. The deque is shared with the thieves,
+// everything after it is only touched by the owner.
+typedef struct stealWorker
+{
+  _Alignas(CACHE_LINE_SIZE) pthread_mutex_t _mutex;  // guards the deque
+  steal_task_t* _deque[STEAL_MAX_PENDING];            // queued tasks, a ring
+  int _top;               // oldest queued task.. thieves take it
+  int _size;
+
+  steal_task_t* _first;   // tasks not written yet, oldest first
+  steal_task_t* _last;
+  int _pending;
+  merge_run_t _carry;     // last user of the written tasks, may continue in the next one
+  uint64_t _tasks;
+  uint64_t _stolen;       // tasks this worker took from the others
+
+} steal_worker_t;
+
+// steal structure schedules the reducers' work as tasks instead of
+// tying all of a channel's tuples to its reducer thread. Every worker
+// queues the sub-batches it reads from its channel; idle workers steal
+// the oldest queued sub-batches of the others, so a hot user's tuples
+// are reduced by every thread. The owner adds the runs up in channel
+// order, so each user is still written once, by its own reducer.
+typedef struct stealStruct
+{
+  // public parameters
+  int numWorkers;
+  channel_bell_t bell;    // rung for new or finished tasks.. attach the channels too
+
+  // functions
+  int (*push)(struct stealStruct* s, int worker, mTupleOut_t* tuples, int n); // queue a sub-batch
+  int (*room)(struct stealStruct* s, int worker);                             // tuples that can still be queued
+  int (*run)(struct stealStruct* s, int worker, output_t* out);              // reduce an own or stolen task
+  int (*write)(struct stealStruct* s, int worker, output_t* out);            // write the finished tasks in order
+  int (*ready)(struct stealStruct* s, int worker);                            // something for the worker to do
+  void (*close)(struct stealStruct* s);                                        // a worker's channel is drained
+  void (*finish)(struct stealStruct* s, int worker, output_t* out);          // write the last user
+
+  // private parameters
+  steal_worker_t* _workers;
+  atomic_int _queued;     // tasks waiting in any deque
+  atomic_int _open;       // workers whose channel is not drained yet
+
+} steal_t;
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+int steal(steal_t* s, int numWorkers);
+void stealDestruct(steal_t* s);
+int stealPush(steal_t* s, int worker, mTupleOut_t* tuples, int n);
+int stealRoom(steal_t* s, int worker);
+int stealRun(steal_t* s, int worker, output_t* out);
+int stealWrite(steal_t* s, int worker, output_t* out);
+int stealReady(steal_t* s, int worker);
+void stealClose(steal_t* s);
+void stealFinish(steal_t* s, int worker, output_t* out);
+int stealDone(steal_t* s);
+void stealStats(steal_t* s, steal_stats_t* stats);
+
+#endif
@@ -0,0 +1,474 @@
+/*
+ * SUMMARY: xsort
+ * This file contains an external merge sort by user id, so input that
+ * interleaves users can be reduced in one pass by the regular reducers,
+ * which need all tuples of a user to arrive together.
+ *
+ * NOTE: Runs are sorted with a two pass LSD radix sort on the user id
+ * (the 4 id characters read as a big endian key), which is stable, and
+ * the k-way merge breaks ties by run number. Runs are numbered in input
+ * order, so the sort as a whole is stable.
+ *
+ * NOTE: All runs share one temp file. The mapper reserves each run's
+ * byte range before the run's thread starts, so the threads write with
+ * pwrite and never need a lock.
+ */
+
+#include <unistd.h>
+#include <errno.h>
+#include "xsort.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+static uint32_t _xsortKey(mTupleOut_t* tuple);
+static void _xsortSortBuf(xsort_buf_t* buf);
+static void* _xsortWorker(void* bufAddr);
+static int _xsortJoin(xsort_buf_t* buf);
+static int _xsortSpill(xsort_t* x);
+static int _xsortStartMerge(xsort_t* x);
+static mTupleOut_t* _xsortHead(xsort_t* x, xsort_cursor_t* cur);
+static int _xsortLess(xsort_t* x, int a, int b);
+static void _xsortSiftDown(xsort_t* x, int i);
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: xsort
+ * initialize a sorter that holds at most about 'budget' bytes
+ * of tuples and sorts up to 'numThreads' runs at once.
+ *
+ * RETURN: 0 on success, -1 if memory cannot be allocated.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int xsort(xsort_t* x, size_t budget, int numThreads)
+{
+  size_t perTuple = sizeof(mTupleOut_t) + 2*sizeof(uint32_t);
+
+  memset(x, 0, sizeof(xsort_t));
+  x->numThreads = numThreads;
+  x->_numBufs = numThreads + 1;
+  x->_fd = -1;
+
+  size_t cap = budget / x->_numBufs / perTuple;
+  x->_capTuples = (cap < XSORT_MIN_TUPLES) ? XSORT_MIN_TUPLES : (int)cap;
+
+  x->_bufs = (xsort_buf_t*)calloc(x->_numBufs, sizeof(xsort_buf_t));
+  if (x->_bufs == NULL)
+    return -1;
+
+  for (int i = 0; i < x->_numBufs; i++)
+  {
+    xsort_buf_t* buf = &x->_bufs[i];
+    buf->tuples = (mTupleOut_t*)malloc(x->_capTuples*sizeof(mTupleOut_t));
+    buf->order = (uint32_t*)malloc(x->_capTuples*sizeof(uint32_t));
+    buf->scratch = (uint32_t*)malloc(x->_capTuples*sizeof(uint32_t));
+    if (buf->tuples == NULL || buf->order == NULL || buf->scratch == NULL)
+      return -1;
+  }
+
+  // connect functions
+  x->add = &xsortAdd;
+  x->read = &xsortRead;
+  return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: xsortDestruct
+ * wait for running threads, deallocate everything and close
+ * (delete) the temp file.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void xsortDestruct(xsort_t* x)
+{
+  for (int i = 0; i < x->_numBufs; i++)
+  {
+    _xsortJoin(&x->_bufs[i]);
+    free(x->_bufs[i].tuples);
+    free(x->_bufs[i].order);
+    free(x->_bufs[i].scratch);
+  }
+  free(x->_bufs);
+  x->_bufs = NULL;
+
+  if (x->_cursors != NULL)
+  {
+    for (int i = 0; i < x->_heapSize; i++)
+      free(x->_cursors[x->_heap[i]].buf);
+  }
+  free(x->_cursors);
+  free(x->_heap);
+  free(x->_runStart);
+  x->_cursors = NULL;
+  x->_heap = NULL;
+  x->_runStart = NULL;
+
+  if (x->_fd != -1)
+    close(x->_fd);
+  x->_fd = -1;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: xsortAdd -> connects to xsort.add
+ * copy a tuple into the current buffer. A full buffer is handed
+ * to a thread that sorts it and writes it out as a run; this only
+ * waits when every buffer is still being written.
+ *
+ * RETURN: 0 on success, -1 if a run could not be written.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int xsortAdd(xsort_t* x, mTupleOut_t* tuple)
+{
+  xsort_buf_t* buf = &x->_bufs[x->_cur];
+
+  buf->tuples[buf->count++] = *tuple;
+  x->tuples++;
+
+  if (buf->count == x->_capTuples)
+    return _xsortSpill(x);
+  return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: xsortRead -> connects to xsort.read
+ * copy up to 'max' tuples, in user id order, into the caller's
+ * array. The first call ends the input: the last buffer is
+ * sorted in memory and merged with the runs on disk.
+ *
+ * RETURN: number of tuples stored, 0 when every tuple was read,
+ * -1 if a run could not be written or read.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int xsortRead(xsort_t* x, mTupleOut_t* tuples, int max)
+{
+  int n = 0;
+
+  if (!x->_merging && _xsortStartMerge(x) == -1)
+    return -1;
+
+  while (n < max && x->_heapSize > 0)
+  {
+    int c = x->_heap[0];
+    xsort_cursor_t* cur = &x->_cursors[c];
+
+    tuples[n++] = *_xsortHead(x, cur);
+    cur->next++;
+
+    // a finished run leaves the heap
+    if (_xsortHead(x, cur) == NULL)
+    {
+      free(cur->buf);
+      cur->buf = NULL;
+      x->_heap[0] = x->_heap[--x->_heapSize];
+    }
+    _xsortSiftDown(x, 0);
+  }
+
+  return n;
+}
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      PRIVATE FUNCTIONS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+// user id as a big endian key, so comparing keys compares the ids
+static uint32_t _xsortKey(mTupleOut_t* tuple)
+{
+  return userKeyOrder(tuple->userid);
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _xsortSortBuf
+ * stable LSD radix sort of the buffer's tuple indices by user id,
+ * low 16 bits first. The tuples themselves don't move.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static void _xsortSortBuf(xsort_buf_t* buf)
+{
+  uint32_t* count = (uint32_t*)malloc((1 << XSORT_RADIX_BITS)*sizeof(uint32_t));
+  uint32_t* src = buf->order;
+  uint32_t* dst = buf->scratch;
+
+  for (int i = 0; i < buf->count; i++)
+    src[i] = i;
+
+  if (count == NULL)
+  {
+    buf->error = -1;
+    return;
+  }
+
+  for (int shift = 0; shift < 32; shift += XSORT_RADIX_BITS)
+  {
+    uint32_t mask = (1 << XSORT_RADIX_BITS) - 1;
+    uint32_t sum = 0;
+
+    memset(count, 0, (1 << XSORT_RADIX_BITS)*sizeof(uint32_t));
+    for (int i = 0; i < buf->count; i++)
+      count[(_xsortKey(&buf->tuples[i]) >> shift) & mask]++;
+
+    for (uint32_t k = 0; k <= mask; k++)
+    {
+      uint32_t c = count[k];
+      count[k] = sum;
+      sum += c;
+    }
+
+    for (int i = 0; i < buf->count; i++)
+    {
+      uint32_t t = src[i];
+      dst[count[(_xsortKey(&buf->tuples[t]) >> shift) & mask]++] = t;
+    }
+
+    uint32_t* swap = src;
+    src = dst;
+    dst = swap;
+  }
+
+  // an even number of passes leaves the result in 'order'
+  free(count);
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _xsortWorker
+ * run thread.. sort a full buffer and write it to its reserved
+ * range of the temp file.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static void* _xsortWorker(void* bufAddr)
+{
+  xsort_buf_t* buf = (xsort_buf_t*)bufAddr;
+  mTupleOut_t* out = (mTupleOut_t*)malloc(XSORT_IO_BATCH*sizeof(mTupleOut_t));
+  off_t offset = buf->offset;
+
+  buf->error = 0;
+  if (out == NULL)
+  {
+    buf->error = -1;
+    return NULL;
+  }
+
+  _xsortSortBuf(buf);
+
+  for (int i = 0; i < buf->count && buf->error == 0; i += XSORT_IO_BATCH)
+  {
+    int n = (buf->count - i < XSORT_IO_BATCH) ? buf->count - i : XSORT_IO_BATCH;
+    for (int k = 0; k < n; k++)
+      out[k] = buf->tuples[buf->order[i + k]];
+
+    size_t len = n*sizeof(mTupleOut_t);
+    if (pwrite(buf->fd, out, len, offset) != (ssize_t)len)
+      buf->error = -1;
+    offset += len;
+  }
+
+  free(out);
+  return NULL;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _xsortJoin
+ * wait for the buffer's run thread, if it has one, and empty
+ * the buffer.
+ *
+ * RETURN: 0, or -1 if the run could not be written.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static int _xsortJoin(xsort_buf_t* buf)
+{
+  if (!buf->busy)
+    return 0;
+
+  pthread_join(buf->thread, NULL);
+  buf->busy = 0;
+  buf->count = 0;
+  return buf->error;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _xsortSpill
+ * hand the current (full) buffer to a run thread and move on to
+ * the next buffer, waiting for its previous run if necessary.
+ *
+ * RETURN: 0 on success, -1 if the temp file or a run failed.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static int _xsortSpill(xsort_t* x)
+{
+  xsort_buf_t* buf = &x->_bufs[x->_cur];
+
+  if (x->_fd == -1)
+  {
+    FILE* file = tmpfile();
+    if (file == NULL)
+      return -1;
+    x->_fd = dup(fileno(file));
+    fclose(file);
+    if (x->_fd == -1)
+      return -1;
+  }
+
+  off_t* runStart = (off_t*)realloc(x->_runStart, (x->runs + 1)*sizeof(off_t));
+  if (runStart == NULL)
+    return -1;
+  x->_runStart = runStart;
+
+  // reserve the run's range of the file
+  x->_runStart[x->runs++] = x->_fileEnd;
+  buf->offset = x->_fileEnd;
+  x->_fileEnd += (off_t)buf->count*sizeof(mTupleOut_t);
+
+  buf->fd = x->_fd;
+  buf->busy = 1;
+  if (pthread_create(&buf->thread, NULL, _xsortWorker, buf) != 0)
+  {
+    // no thread.. write the run from here instead
+    buf->busy = 0;
+    _xsortWorker(buf);
+    buf->count = 0;
+    if (buf->error)
+      return -1;
+  }
+
+  x->_cur = (x->_cur + 1) % x->_numBufs;
+  return _xsortJoin(&x->_bufs[x->_cur]);
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _xsortStartMerge
+ * wait for every run, sort the last buffer in memory and build
+ * the merge heap: one cursor per run, in input order, with the
+ * in-memory buffer last.
+ *
+ * RETURN: 0 on success, -1 on error.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static int _xsortStartMerge(xsort_t* x)
+{
+  xsort_buf_t* last = &x->_bufs[x->_cur];
+  int error = 0;
+
+  x->_merging = 1;
+  for (int i = 0; i < x->_numBufs; i++)
+    error |= _xsortJoin(&x->_bufs[i]);
+  if (error)
+    return -1;
+
+  _xsortSortBuf(last);
+  if (last->error)
+    return -1;
+
+  int numCursors = (int)x->runs + 1;
+  x->_cursors = (xsort_cursor_t*)calloc(numCursors, sizeof(xsort_cursor_t));
+  x->_heap = (int*)malloc(numCursors*sizeof(int));
+  if (x->_cursors == NULL || x->_heap == NULL)
+    return -1;
+
+  for (int r = 0; r < numCursors; r++)
+  {
+    xsort_cursor_t* cur = &x->_cursors[r];
+
+    if (r == (int)x->runs)
+      cur->mem = last;
+    else
+    {
+      cur->pos = x->_runStart[r];
+      cur->end = (r + 1 < (int)x->runs) ? x->_runStart[r + 1] : x->_fileEnd;
+      cur->buf = (mTupleOut_t*)malloc(XSORT_IO_BATCH*sizeof(mTupleOut_t));
+      if (cur->buf == NULL)
+        return -1;
+    }
+
+    if (_xsortHead(x, cur) != NULL)
+      x->_heap[x->_heapSize++] = r;
+    else
+    {
+      free(cur->buf);
+      cur->buf = NULL;
+    }
+  }
+
+  for (int i = x->_heapSize/2 - 1; i >= 0; i--)
+    _xsortSiftDown(x, i);
+  return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _xsortHead
+ * the next unread tuple of a run, reading XSORT_IO_BATCH more
+ * tuples from the temp file when the buffer is used up.
+ *
+ * RETURN: the tuple, NULL once the run is exhausted.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+static mTupleOut_t* _xsortHead(xsort_t* x, xsort_cursor_t* cur)
+{
+  if (cur->mem != NULL)
+    return (cur->next < cur->mem->count) ? &cur->mem->tuples[cur->mem->order[cur->next]] : NULL;
+
+  if (cur->next == cur->count)
+  {
+    off_t left = cur->end - cur->pos;
+    size_t want = XSORT_IO_BATCH*sizeof(mTupleOut_t);
+    if (left < (off_t)want)
+      want = (size_t)left;
+    if (want == 0)
+      return NULL;
+
+    ssize_t len = pread(x->_fd, cur->buf, want, cur->pos);
+    if (len < (ssize_t)sizeof(mTupleOut_t))
+      return NULL;
+
+    cur->count = len / sizeof(mTupleOut_t);
+    cur->next = 0;
+    cur->pos += (off_t)cur->count*sizeof(mTupleOut_t);
+  }
+
+  return &cur->buf[cur->next];
+}
+
+// heap order.. user id, then run number (input order)
+static int _xsortLess(xsort_t* x, int a, int b)
+{
+  uint32_t ka = _xsortKey(_xsortHead(x, &x->_cursors[a]));
+  uint32_t kb = _xsortKey(_xsortHead(x, &x->_cursors[b]));
+  return (ka < kb) || (ka == kb && a < b);
+}
+
+static void _xsortSiftDown(xsort_t* x, int i)
+{
+  while (1)
+  {
+    int l = 2*i + 1, r = l + 1, min = i;
+    if (l < x->_heapSize && _xsortLess(x, x->_heap[l], x->_heap[min]))
+      min = l;
+    if (r < x->_heapSize && _xsortLess(x, x->_heap[r], x->_heap[min]))
+      min = r;
+    if (min == i)
+      return;
+
+    int swap = x->_heap[i];
+    x->_heap[i] = x->_heap[min];
+    x->_heap[min] = swap;
+    i = min;
+  }
+}
@@ -0,0 +1,98 @@
+#ifndef _XSORT_SRC_HEADER_
+#define _XSORT_SRC_HEADER_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "common.h"
+#include "mapper.h"
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      DEFINES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+#define XSORT_IO_BATCH      1024      // tuples per pwrite/pread of a run
+#define XSORT_RADIX_BITS    16        // user id key is sorted 16 bits per pass
+#define XSORT_MIN_TUPLES    1024      // smallest run buffer, whatever the budget
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      TYPEDEFS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+// one buffer of tuples on its way to becoming a sorted run. While
+// 'busy', a worker thread owns it and the mapper must not touch it.
+typedef struct xsortBuf
+{
+  mTupleOut_t* tuples;
+  uint32_t* order;        // tuples[order[i]] is the i-th smallest
+  uint32_t* scratch;      // second index array for the radix passes
+  int count;
+  int busy;
+  pthread_t thread;
+  int fd;                 // temp file
+  off_t offset;           // where the run goes in the temp file
+  int error;
+} xsort_buf_t;
+
+// read position in one run during the merge. The last buffer is merged
+// straight from memory (mem != NULL) instead of being written out.
+typedef struct xsortCursor
+{
+  off_t pos;
+  off_t end;
+  int next;
+  int count;
+  mTupleOut_t* buf;
+  xsort_buf_t* mem;
+} xsort_cursor_t;
+
+// xsort structure is an external merge sort by user id in front of the
+// reducers. Tuples are collected in one of numThreads + 1 buffers that
+// share the memory budget; a full buffer is sorted and written to a temp
+// file as a run by its own thread while the mapper fills the next one.
+// At EOF the runs are merged k-way. Ties keep input order, so the
+// topics of a user reach the reducer in the order they were read.
+typedef struct xsortStruct
+{
+  // public parameters
+  int numThreads;         // runs sorted/written at the same time
+  uint64_t runs;          // runs written to the temp file
+  uint64_t tuples;        // tuples added
+
+  // functions
+  int (*add)(struct xsortStruct* x, mTupleOut_t* tuple);              // copy one tuple in
+  int (*read)(struct xsortStruct* x, mTupleOut_t* tuples, int max);   // sorted tuples, 0 when done
+
+  // private parameters
+  xsort_buf_t* _bufs;
+  int _numBufs;
+  int _cur;               // buffer being filled
+  int _capTuples;         // tuples per buffer
+  int _fd;                // temp file, -1 until the first run
+  off_t _fileEnd;
+  off_t* _runStart;       // file offset of each run, in input order
+  int _merging;
+  xsort_cursor_t* _cursors;
+  int* _heap;             // cursor indices, smallest head first
+  int _heapSize;
+} xsort_t;
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                      PROTOTYPES
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ */
+
+int xsort(xsort_t* x, size_t budget, int numThreads);
+void xsortDestruct(xsort_t* x);
+int xsortAdd(xsort_t* x, mTupleOut_t* tuple);
+int xsortRead(xsort_t* x, mTupleOut_t* tuples, int max);
+
+#endif
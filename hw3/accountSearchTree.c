@@ -1,14 +1,23 @@
 /*
  * SUMMARY: accountSearchTree.c
- * This file contains functions for the tree data structure that will hold all
- * bank account information. 
+ * This file contains functions for the data structure that will hold all
+ * bank account information.
  *
- * NOTE: All functions use the root account pointer defined in the "globals" section
+ * NOTE: All functions use the account store defined in the "globals" section
  *      so a tree pointer does not have to be passed in.
  *
- * NOTE: This class was originally set up as a binary search tree; however, it has 
- *    been updated to run as a linked list. This change was to assist in meeting the
- *    requirement to output accounts in the order they were read in.
+ * NOTE: This class was originally set up as a binary search tree, and later as a
+ *    linked list to output accounts in the order they were read in. Searching the
+ *    list made every transfer O(accounts), so the accounts are now kept in a vector
+ *    (insertion order, for printing) plus an open addressing hash index keyed by
+ *    account number (for lookups). Account numbers can be sparse, so the index is
+ *    hashed instead of being a dense array.
+ *
+ * NOTE: The vector and index are guarded by a read-mostly lock (lockAccounts).
+ *    Transfers only take it for reading while they look up their two accounts,
+ *    then lock just those accounts, lowest account number first. Every transfer
+ *    takes the locks in the same order, so no two can deadlock and transfers on
+ *    disjoint accounts run in parallel.
  */
 
 #include "accountSearchTree.h"
@@ -19,9 +28,12 @@
 * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
 */
 
-account_t* root;
-account_t* tail;
-pthread_mutex_t mutexTransfer;
+account_t** accounts;
+int numAccounts;
+int capAccounts;
+account_slot_t* accountIndex;   // linear probe table, (accountIndexMask + 1) slots
+uint32_t accountIndexMask;
+pthread_rwlock_t lockAccounts = PTHREAD_RWLOCK_INITIALIZER;
 
 /*
 * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
@@ -31,125 +43,210 @@ pthread_mutex_t mutexTransfer;
 
 /*
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
- * SUMMARY: initAccountTree
- * This function initializes the root of the tree to be NULL
+ * SUMMARY: initAccountStore
+ * This function allocates the empty account vector and index
  * so the "addAccount" function can work.
+ *
+ * NOTE: Returns -1 if the store cannot be allocated.
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
  */
-void initAccountLinkedList()
+int initAccountStore()
 {
-  pthread_mutex_lock(&mutexTransfer);
-  root = NULL;
-  tail = NULL;
-  mutexTransfer = (pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER;
-  pthread_mutex_unlock(&mutexTransfer);
+  pthread_rwlock_wrlock(&lockAccounts);
+  numAccounts = 0;
+  capAccounts = ACCOUNT_INIT_CAPACITY;
+  accounts = (account_t**)malloc(capAccounts*sizeof(account_t*));
+  accountIndexMask = ACCOUNT_INIT_CAPACITY - 1;
+  accountIndex = (account_slot_t*)calloc(accountIndexMask + 1, sizeof(account_slot_t));
+  pthread_rwlock_unlock(&lockAccounts);
+
+  if (accounts == NULL || accountIndex == NULL)
+    return -1;
+  return 0;
 }
 
 /*
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
  * SUMMARY: addAccount
- * This function adds a new account to the unbalanced binary
- * search tree.
+ * This function adds a new account to the end of the account
+ * vector and to the index.
+ *
+ * NOTE: If an account number is defined twice, both are printed
+ *    but transfers use the first one (as the linked list did).
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
  */
 int addAccount(int account_number, int starting_balance)
 {
   account_t* node = (account_t*)malloc(sizeof(account_t));
+  if (node == NULL)
+    return -1;
   node->account_number = account_number;
   node->balance = starting_balance;
-  node->next = NULL;
   node->mutex = (pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER;
 
-  pthread_mutex_lock(&mutexTransfer);
+  pthread_rwlock_wrlock(&lockAccounts);
 
-  // Base case.. initializing the root.
-  if (root == NULL)
+  // grow the vector.. only the pointers move, so the accounts
+  // (and their mutexes) stay where they are.
+  if (numAccounts == capAccounts)
   {
-    root = node;
-    tail = node;
-    pthread_mutex_unlock(&mutexTransfer);
-    return 0;
+    account_t** grown = (account_t**)realloc(accounts, 2*capAccounts*sizeof(account_t*));
+    if (grown == NULL)
+    {
+      pthread_rwlock_unlock(&lockAccounts);
+      free(node);
+      return -1;
+    }
+    accounts = grown;
+    capAccounts *= 2;
   }
 
-  // add to the end of the linked list.
-  else
+  // keep the index at most 3/4 full so probe sequences stay short.
+  if ((uint32_t)(numAccounts + 1)*4 > (accountIndexMask + 1)*3 && _growAccountIndex() == -1)
   {
-    tail->next = node;
-    tail = node;
-    pthread_mutex_unlock(&mutexTransfer);
-    return 0;
+    pthread_rwlock_unlock(&lockAccounts);
+    free(node);
+    return -1;
   }
 
-  return -1;
+  uint32_t i = _accountMix((uint32_t)account_number) & accountIndexMask;
+  while (accountIndex[i].account != NULL && accountIndex[i].account_number != account_number)
+    i = (i + 1) & accountIndexMask;
+
+  if (accountIndex[i].account == NULL)
+  {
+    accountIndex[i].account_number = account_number;
+    accountIndex[i].account = node;
+  }
+  accounts[numAccounts++] = node;
+
+  pthread_rwlock_unlock(&lockAccounts);
+  return 0;
 }
 
 /*
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
  * SUMMARY: accountTransaction
  * This function attempts to transfer the value from source
- * account to destination account. 
+ * account to destination account.
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
  */
 int accountTransaction(int src_account, int dst_account, int value)
 {
-  // find the account nodes that will be changed.
-  pthread_mutex_lock(&mutexTransfer);
-  account_t* srcNode = _searchLinkedList(root, src_account);
-  account_t* destNode = _searchLinkedList(root, dst_account);
+  // find the account nodes that will be changed. Accounts are never
+  // freed or moved while transfers run, so the pointers stay valid
+  // once the read lock is released.
+  pthread_rwlock_rdlock(&lockAccounts);
+  account_t* srcNode = _searchAccountIndex(src_account);
+  account_t* destNode = _searchAccountIndex(dst_account);
+  pthread_rwlock_unlock(&lockAccounts);
   if (srcNode == NULL || destNode == NULL)
   {
     printf("ERROR: Source (%d) OR destination (%d) could not be found.\n", src_account, dst_account);
-    pthread_mutex_unlock(&mutexTransfer);
     return -1;
   }
 
-  // atomically check if both locks are available. If yes, claim both..
-  // If not, don't claim either and return.
-  // Do this section atomically so to avoid deadlocks. 
-  if (pthread_mutex_lock(&srcNode->mutex) > 0) // try to claim source
-  {
-    pthread_mutex_unlock(&mutexTransfer);
-    return -1;
-  }
+  // claim both accounts in account number order so two transfers
+  // between the same accounts can never wait on each other. A
+  // transfer to the same account only takes its lock once.
+  account_t* first = (srcNode->account_number < destNode->account_number) ? srcNode : destNode;
+  account_t* second = (first == srcNode) ? destNode : srcNode;
 
-  if (pthread_mutex_lock(&destNode->mutex) > 0) // try to claim destination
+  if (pthread_mutex_lock(&first->mutex) != 0)
+    return -1;
+  if (second != first && pthread_mutex_lock(&second->mutex) != 0)
   {
-    pthread_mutex_unlock(&mutexTransfer);
+    pthread_mutex_unlock(&first->mutex);
     return -1;
   }
-  pthread_mutex_unlock(&mutexTransfer);
 
   // transfer balance from source to destination
   srcNode->balance -= value;
   destNode->balance += value;
 
   // unlock the src/dest nodes so other threads can complete.
-  pthread_mutex_unlock(&srcNode->mutex);
-  pthread_mutex_unlock(&destNode->mutex);
+  if (second != first)
+    pthread_mutex_unlock(&second->mutex);
+  pthread_mutex_unlock(&first->mutex);
 
   //printf("Transaction complete\n");
   return 0;
 }
 
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: findAccount
+ * This function looks up an account by its number. It returns
+ * NULL if there is no such account.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+account_t* findAccount(int account_number)
+{
+  pthread_rwlock_rdlock(&lockAccounts);
+  account_t* node = _searchAccountIndex(account_number);
+  pthread_rwlock_unlock(&lockAccounts);
+  return node;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: accountDefined
+ * This function returns 1 if the account was added, 0 if not.
+ *
+ * NOTE: Only the thread that calls "addAccount" may use this. It
+ *    skips lockAccounts, since no other thread changes the index.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int accountDefined(int account_number)
+{
+  return _searchAccountIndex(account_number) != NULL;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: accountOwner
+ * This function returns which of 'numOwners' shards an account
+ * number belongs to.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int accountOwner(int account_number, int numOwners)
+{
+  return (int)(_accountMix((uint32_t)account_number) % (uint32_t)numOwners);
+}
+
 /*
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
  * SUMMARY: printAccountContents
- * This function prints the in-order contents of each account in
- * the tree.
+ * This function prints the contents of each account in the
+ * order the accounts were added.
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
  */
 void printAccountContents()
 {
-  pthread_mutex_lock(&mutexTransfer);
-  _printInOrderContents(root);
-  pthread_mutex_unlock(&mutexTransfer);
+  pthread_rwlock_rdlock(&lockAccounts);
+  for (int i = 0; i < numAccounts; i++)
+    printf("%d %d\n", accounts[i]->account_number, accounts[i]->balance);
+  pthread_rwlock_unlock(&lockAccounts);
 }
 
-void destroyAccountLinkedList()
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: destroyAccountStore
+ * This function deallocates every account, the vector and the
+ * index.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void destroyAccountStore()
 {
-  pthread_mutex_lock(&mutexTransfer);
-  _destroyLinkedList(root);
-  pthread_mutex_unlock(&mutexTransfer);
+  pthread_rwlock_wrlock(&lockAccounts);
+  for (int i = 0; i < numAccounts; i++)
+    free(accounts[i]);
+  free(accounts);
+  free(accountIndex);
+  accounts = NULL;
+  accountIndex = NULL;
+  numAccounts = 0;
+  pthread_rwlock_unlock(&lockAccounts);
 }
 
 /*
@@ -160,51 +257,72 @@ void destroyAccountLinkedList()
 
 /*
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
- * SUMMARY: _destroyLinkedList
- * This function recursively destroys the linked list.
+ * SUMMARY: _accountMix
+ * murmur3 finalizer. Account numbers are often sequential, so
+ * their bits are spread before they are masked into the index.
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
  */
-void _destroyLinkedList(account_t* root)
+uint32_t _accountMix(uint32_t x)
 {
-  if (root == NULL)
-    return;
-
-  _destroyLinkedList(root->next);
-  free(root);
+  x ^= x >> 16;
+  x *= 0x85ebca6bu;
+  x ^= x >> 13;
+  x *= 0xc2b2ae35u;
+  x ^= x >> 16;
+  return x;
 }
 
 /*
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
- * SUMMARY: _printInOrderContents
- * This function recursively prints the in-order contents of the
- * accounts in the linked list.
+ * SUMMARY: _growAccountIndex
+ * This function doubles the index and re-inserts every slot.
+ * Must be called with lockAccounts held for writing.
+ *
+ * NOTE: Returns -1 if the new index cannot be allocated.
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
  */
-void _printInOrderContents(account_t* root)
+int _growAccountIndex()
 {
-  if (root == NULL)
-    return;
+  uint32_t newMask = (accountIndexMask << 1) | 1;
+  account_slot_t* slots = (account_slot_t*)calloc(newMask + 1, sizeof(account_slot_t));
+  if (slots == NULL)
+    return -1;
+
+  for (uint32_t i = 0; i <= accountIndexMask; i++)
+  {
+    if (accountIndex[i].account == NULL)
+      continue;
 
-  printf("%d %d\n", root->account_number, root->balance);
-  _printInOrderContents(root->next);
+    uint32_t j = _accountMix((uint32_t)accountIndex[i].account_number) & newMask;
+    while (slots[j].account != NULL)
+      j = (j + 1) & newMask;
+    slots[j] = accountIndex[i];
+  }
+
+  free(accountIndex);
+  accountIndex = slots;
+  accountIndexMask = newMask;
+  return 0;
 }
 
 /*
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
- * SUMMARY: _searchTree
- * This function recursively searches for a node with a provided
- * key. If the key is not found, it will return NULL.
+ * SUMMARY: _searchAccountIndex
+ * This function looks up the account with a provided key. If the
+ * key is not found, it will return NULL. Must be called with
+ * lockAccounts held.
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
  */
-account_t* _searchLinkedList(account_t* root, int account)
+account_t* _searchAccountIndex(int account)
 {
-  // key was not found.
-  if (root == NULL)
-    return NULL;
-
-  // key was found.
-  if (root->account_number == account)
-    return root;
-  else
-    return _searchLinkedList(root->next, account);
+  uint32_t i = _accountMix((uint32_t)account) & accountIndexMask;
+
+  // an unused slot ends the probe sequence.. key was not found.
+  while (accountIndex[i].account != NULL)
+  {
+    if (accountIndex[i].account_number == account)
+      return accountIndex[i].account;
+    i = (i + 1) & accountIndexMask;
+  }
+  return NULL;
 }
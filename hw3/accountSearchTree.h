@@ -9,6 +9,14 @@
 #include <sys/wait.h>
 #include <pthread.h>
 
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ *                       DEFINES
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+
+#define ACCOUNT_INIT_CAPACITY   64  // initial size of the account vector + index (power of 2)
+
 /*
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
  *                  TYPEDEFS / STRUCTS
@@ -20,34 +28,25 @@
  * account_number - account number, which will be used as the struct's key.
  * balance - amount of money in the account.
  * mutex - lock used to make sure the resource is not accessed by multiple threads.
- * left_node - node of an account with a smaller account number.
- * right_node - node of an account with a larger account number.
  */
 typedef struct account
 {
   // account properties
-  int account_number;    // multiple readers are allowed outside of "addAccount." (works for tree traversal)
+  int account_number;    // multiple readers are allowed outside of "addAccount."
   int balance;           // only one reader OR writer is allowed at a time.
   pthread_mutex_t mutex;
-
-  // linked list properties
-  struct account* next;
 } account_t;
 
 /*
- * SUMMARY: transfer_buffer_t
- * empty - this flag will be set to 1 whenever it can be written to.
- * src - source account number for the transfer.
- * dest - destination account number for the transfer.
- * amount - amount of money being transferred from source -> destination.
+ * SUMMARY: account_slot_t
+ * account_number - key of the slot.
+ * account - account with that number, NULL while the slot is unused.
  */
-typedef struct transfer_buffer
+typedef struct account_slot
 {
-  int empty;
-  int src;
-  int dest;
-  int amount;
-} transfer_buffer_t;
+  int account_number;
+  account_t* account;
+} account_slot_t;
 
  /*
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
@@ -55,8 +54,9 @@ typedef struct transfer_buffer
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
  */
 
-extern account_t* root;
-extern pthread_mutex_t mutexTransfer;
+extern account_t** accounts;   // every account, in the order it was read in
+extern int numAccounts;
+extern pthread_rwlock_t lockAccounts;
 
 /*
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
@@ -65,15 +65,18 @@ extern pthread_mutex_t mutexTransfer;
  */
 
 // PUBLIC
-void initAccountLinkedList();
+int initAccountStore();
 int addAccount(int account_number, int starting_balance);
 int accountTransaction(int src_account, int dst_account, int value);
-void destroyAccountLinkedList();
+account_t* findAccount(int account_number);
+int accountDefined(int account_number);
+int accountOwner(int account_number, int numOwners);
+void destroyAccountStore();
 void printAccountContents();
 
 // PRIVATE
-void _destroyLinkedList(account_t* root);
-void _printInOrderContents(account_t* root);
-account_t* _searchLinkedList(account_t* root, int account);
+uint32_t _accountMix(uint32_t x);
+int _growAccountIndex();
+account_t* _searchAccountIndex(int account);
 
 #endif
\ No newline at end of file
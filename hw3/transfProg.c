@@ -5,8 +5,11 @@
 #include <sys/wait.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <getopt.h>
 
 #include "accountSearchTree.h"
+#include "transferQueue.h"
+#include "waveScheduler.h"
 
 /*
  * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
@@ -14,13 +17,23 @@
  * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
  */
 
-pthread_mutex_t mutexComplete;
-int flagComplete;
 int numWorkers;
 pthread_t rthread;
 pthread_t* wthread;
-pthread_mutex_t* mutexWorkerBuffer;
-transfer_buffer_t* workerBuffer;
+transfer_queue_t transferQueue;   // reader -> workers
+
+// wave mode (-w).. the reader splits each window of transfers into
+// conflict free waves and only queues a wave once the last one ran.
+int waveWindow;
+wave_scheduler_t scheduler;
+
+// shard mode (-s).. worker i owns the accounts with accountOwner() == i
+// and is the only thread that touches their balances. The reader sends
+// it transfers through its own mailbox, a batch per shard at a time.
+int shardMode;
+transfer_queue_t* mailboxes;
+transfer_t* shardBatch;   // TRANSFER_BATCH_SIZE per shard.. reader only
+int* shardCount;
 
 /*
  * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
@@ -29,9 +42,11 @@ transfer_buffer_t* workerBuffer;
  */
 
 void* reader(void* fid);
-void* worker(void* dummy);
-int isReaderComplete();
-void markReaderComplete();
+void* worker(void* workerNum);
+void runWaves();
+void sendToShards(int src, int dest, int amount);
+void flushShard(int shard);
+void* shardWorker(int shard);
 
 /*
  * +=====+=====+=====+=====+=====+=====+=====+=====+=====+
@@ -44,46 +59,87 @@ int main(int argc, char **argv)
   FILE* inputFid;
   
   // -------------------------------------------------------
-  // turn off stdout/stdin buffers + init tree
+  // turn off stdout/stdin buffers + init account store
   // -------------------------------------------------------
 
   setbuf(stdout, NULL);
   setbuf(stdin, NULL);
-  initAccountLinkedList();
+  if (initAccountStore() == -1)
+  {
+    printf("ERROR: Allocating the account store.\n");
+    return -1;
+  }
 
   // -------------------------------------------------------
   // handle command line arguments
   // -------------------------------------------------------
 
-  if ((inputFid = fopen(argv[1], "r")) == NULL)
+  // ./transfProg [-w windowSize | -s] InputFile NumWorkers
+  int opt;
+  int badArgs = 0;
+  while ((opt = getopt(argc, argv, "w:s")) != -1)
+  {
+    if (opt == 'w')
+      badArgs |= ((waveWindow = atoi(optarg)) <= 0);
+    else if (opt == 's')
+      shardMode = 1;
+    else
+      badArgs = 1;
+  }
+  if (badArgs || argc - optind < 2 || (waveWindow > 0 && shardMode))
+  {
+    printf("ERROR: Expecting ./transfProg [-w windowSize | -s] InputFile NumWorkers\n");
+    return -1;
+  }
+
+  if ((inputFid = fopen(argv[optind], "r")) == NULL)
   {
     printf("ERROR: Opening input file - first argument (string) InputFile.\n");
     return -1;
   }
-  if ((numWorkers = atoi(argv[2])) == 0)
+  if ((numWorkers = atoi(argv[optind + 1])) <= 0)
   {
     printf("ERROR: Second input argument (integer) NumWorkers.\n");
     return -1;
   }
 
   // -------------------------------------------------------
-  // initialize mutex and buffer connecting the reader thread 
-  // and the worker threads.
+  // initialize the queue connecting the reader thread and
+  // the worker threads.
   // -------------------------------------------------------
 
-  mutexComplete = (pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER;
-  mutexWorkerBuffer = (pthread_mutex_t*)malloc(numWorkers*sizeof(pthread_mutex_t));
-  for (int i = 0; i < numWorkers; i++)
-    mutexWorkerBuffer[i] = (pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER;
+  // only a wave has to be spread over every worker.. otherwise a
+  // pop takes a whole batch.
+  if (initTransferQueue(&transferQueue, TRANSFER_QUEUE_SIZE, (waveWindow > 0) ? numWorkers : 1) == -1)
+  {
+    printf("ERROR: Allocating the transfer queue.\n");
+    return -1;
+  }
+  if (waveWindow > 0 && initWaveScheduler(&scheduler, waveWindow) == -1)
+  {
+    printf("ERROR: Allocating the wave scheduler.\n");
+    return -1;
+  }
 
-  // all worker buffer empty flags will be set to mark that they can be filled immediately.
-  workerBuffer = (transfer_buffer_t*)malloc(numWorkers*sizeof(transfer_buffer_t));
-  for (int i = 0; i < numWorkers; i++)
+  // one mailbox per shard, each read by its owner only.
+  if (shardMode)
   {
-    workerBuffer[i].empty = 1;
-    workerBuffer[i].src = -1;
-    workerBuffer[i].dest = -1;
-    workerBuffer[i].amount = -1;
+    mailboxes = (transfer_queue_t*)malloc(numWorkers*sizeof(transfer_queue_t));
+    shardBatch = (transfer_t*)malloc(numWorkers*TRANSFER_BATCH_SIZE*sizeof(transfer_t));
+    shardCount = (int*)calloc(numWorkers, sizeof(int));
+    if (mailboxes == NULL || shardBatch == NULL || shardCount == NULL)
+    {
+      printf("ERROR: Allocating the shard mailboxes.\n");
+      return -1;
+    }
+    for (int i = 0; i < numWorkers; i++)
+    {
+      if (initTransferQueue(&mailboxes[i], TRANSFER_QUEUE_SIZE, 1) == -1)
+      {
+        printf("ERROR: Allocating the shard mailboxes.\n");
+        return -1;
+      }
+    }
   }
 
   // initialize worker threads.
@@ -107,7 +163,19 @@ int main(int argc, char **argv)
     pthread_join(wthread[i], NULL);
 
   printAccountContents();
-  destroyAccountLinkedList();
+  destroyAccountStore();
+  destroyTransferQueue(&transferQueue);
+  if (waveWindow > 0)
+    destroyWaveScheduler(&scheduler);
+  if (shardMode)
+  {
+    for (int i = 0; i < numWorkers; i++)
+      destroyTransferQueue(&mailboxes[i]);
+    free(mailboxes);
+    free(shardBatch);
+    free(shardCount);
+  }
+  free(wthread);
 
   // close the input file descriptor
   if (fclose(inputFid) != 0)
@@ -123,9 +191,10 @@ int main(int argc, char **argv)
 /*
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
  * SUMMARY: reader
- * This thread reads from the input file and assigns work
- * to an available worker thread. Once the EOF is reached
- * it will signal the worker threads and exit. 
+ * This thread reads from the input file and queues the
+ * transfers for the worker threads, TRANSFER_BATCH_SIZE at a
+ * time (or a wave at a time in wave mode). Once the EOF is
+ * reached it will close the queue and exit.
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
  */
 void* reader(void* inputFid)
@@ -134,6 +203,9 @@ void* reader(void* inputFid)
   char * line = NULL;
   size_t len = 0;
   ssize_t read;
+  transfer_t batch[TRANSFER_BATCH_SIZE];
+  int batchCount = 0;
+  int unknownQueued = 0;  // a queued transfer names an account not defined yet
   
   // read all lines of the file and determine if the line is
   // an account number or a transfer..
@@ -146,9 +218,8 @@ void* reader(void* inputFid)
     {
       char* token; 
       char* rest = line; 
-      pthread_mutex_t* mutex = NULL;
-      transfer_buffer_t* buf = NULL;
       int count = 0;
+      int valid = 1;
 
       // transfer information
       int src = -1;
@@ -164,6 +235,7 @@ void* reader(void* inputFid)
           if ((src = atoi(token)) == 0)
           {
             printf("ERROR: (integer) 'source' account number is invalid.\n");
+            valid = 0;
             break;
           }
         }
@@ -174,6 +246,7 @@ void* reader(void* inputFid)
           if ((dest = atoi(token)) == 0)
           {
             printf("ERROR: (integer) 'destination' account number is invalid.\n");
+            valid = 0;
             break;
           }
         }
@@ -184,6 +257,7 @@ void* reader(void* inputFid)
           if ((amount = atoi(token)) == 0)
           {
             printf("ERROR: (integer) 'amount' is invalid.\n");
+            valid = 0;
             break;
           }
         }
@@ -192,41 +266,45 @@ void* reader(void* inputFid)
         else if (count > 3)
         {
           printf("ERROR: More than 4 arguments for transfer request.\n");
+          valid = 0;
           break;
         }
 
         count++;
       }
 
-      // find a channel that is available to write to and claim the mutex.
-      // if none are available immediately, continue looping until one is found.
-      int foundABuffer = 0;
-      do
+      // a malformed transfer is skipped.. no worker could ever complete it.
+      if (!valid || count < 4)
+        continue;
+
+      // shard mode.. hand the transfer to the owners of its accounts.
+      if (shardMode)
       {
-        for (int i = 0; i < numWorkers; i++)
-        {
-          mutex = &mutexWorkerBuffer[i];
-          buf = &workerBuffer[i];
+        sendToShards(src, dest, amount);
+        continue;
+      }
 
-          // try to claim the lock.. if it is unavailable, check the next lock.
-          if (pthread_mutex_lock(mutex) == 0)
-          {
-            // claimed the lock.. transfer data into the buffer if it is empty.
-            if (buf->empty)
-            {
-              buf->empty = 0;
-              buf->amount = amount;
-              buf->src = src;
-              buf->dest = dest;
-              foundABuffer = 1;
-              //printf("Txd (%d) - src: %d, dest: %d, amount: %d\n", i, src, dest, amount);
-              pthread_mutex_unlock(mutex);
-              break;
-            }
-            pthread_mutex_unlock(mutex);
-          }
-        }
-      } while (!foundABuffer);
+      // wave mode.. collect a window, then run it wave by wave.
+      if (waveWindow > 0)
+      {
+        addTransfer(&scheduler, src, dest, amount);
+        if (scheduler.count == scheduler.capacity)
+          runWaves();
+        continue;
+      }
+
+      // queue the transfers a batch at a time.. the push only sleeps
+      // if the workers are TRANSFER_QUEUE_SIZE transfers behind.
+      if (!unknownQueued && (!accountDefined(src) || !accountDefined(dest)))
+        unknownQueued = 1;
+      batch[batchCount].src = src;
+      batch[batchCount].dest = dest;
+      batch[batchCount].amount = amount;
+      if (++batchCount == TRANSFER_BATCH_SIZE)
+      {
+        pushTransfers(&transferQueue, batch, batchCount);
+        batchCount = 0;
+      }
     }
 
     // Initializing an account number + starting balance.
@@ -274,73 +352,66 @@ void* reader(void* inputFid)
         count++;
       }
 
-      // If the account details were valid, add it to the account tree.
-      if (account_number > 0 && account_balance > 0)
-        addAccount(account_number, account_balance);
+      // transfers read before this account must not see it.. run them first.
+      // The queue only has to drain if one of them names a missing account.
+      // (shard mode looks the accounts up as it reads, so it never does)
+      if (waveWindow > 0 && scheduler.count > 0)
+        runWaves();
+      else if (unknownQueued)
+      {
+        pushTransfers(&transferQueue, batch, batchCount);
+        batchCount = 0;
+        waitTransfers(&transferQueue);
+        unknownQueued = 0;
+      }
+
+      // If the account details were valid, add it to the account store.
+      if (account_number > 0 && account_balance > 0 && addAccount(account_number, account_balance) == -1)
+        printf("ERROR: Could not allocate account (%d).\n", account_number);
     }
   }
 
-  // signal the worker threads that there will not be any more input.
-  markReaderComplete();
+  // queue the last partial batch (or window) + signal the worker
+  // threads that there will not be any more input.
+  if (waveWindow > 0 && scheduler.count > 0)
+    runWaves();
+  pushTransfers(&transferQueue, batch, batchCount);
+  closeTransferQueue(&transferQueue);
+  for (int i = 0; shardMode && i < numWorkers; i++)
+  {
+    flushShard(i);
+    closeTransferQueue(&mailboxes[i]);
+  }
+  free(line);
   return NULL;
 }
 
 /*
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
  * SUMMARY: worker
- * This thread reads from its assigned channel and performs
- * account transfers.
+ * This thread pulls batches of transfers from the queue and
+ * performs them, until the queue is closed and empty.
+ *
+ * NOTE: A transfer sees exactly the accounts defined above it in
+ *    the file. One naming any other account is reported once and
+ *    skipped, the same as in wave and shard mode. The reader only
+ *    drains the queue before adding an account if such a transfer
+ *    is queued, so it fails before the account exists.
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
  */
-void* worker(void* channel)
+void* worker(void* workerNum)
 {
-  int bufferChannel = (int)(long long)channel;
-  pthread_mutex_t* mutex = &mutexWorkerBuffer[bufferChannel];
-  transfer_buffer_t* buf = &workerBuffer[bufferChannel];
+  transfer_t batch[TRANSFER_BATCH_SIZE];
+  int numTransfers;
 
-  // transfer variables
-  int src;      // copy of the source account.
-  int dest;     // copy of the destination account.
-  int amount;   // copy of the amount of money to be transferred.
-  int transfer; // 1 if transfer can be completed. 0 if it cannot.
+  if (shardMode)
+    return shardWorker((int)(long long)workerNum);
 
-  while(1)
+  while ((numTransfers = popTransfers(&transferQueue, batch, TRANSFER_BATCH_SIZE)) > 0)
   {
-    src = -1;
-    dest = -1;
-    amount = -1;
-    transfer = 0;
-
-    // Copy data from the transfer buffer + set the empty flag 
-    // so more data can be transferred to this channel.
-    pthread_mutex_lock(mutex);
-    if (buf->empty == 0)
-    {
-      src = buf->src;
-      dest = buf->dest;
-      amount = buf->amount;
-      buf->empty = 1;
-      transfer = 1;
-      //printf("Rxd (%d) - src: %d, dest: %d, amount: %d\n", bufferChannel, src, dest, amount);
-    }
-    else if (buf->empty == 1 && isReaderComplete())
-    {
-      //printf("Ending worker thread: (%d)\n", bufferChannel);
-      break;
-    }
-    pthread_mutex_unlock(mutex);
-
-    // Wait for the source + destination to both be available.
-    if (transfer)
-    {
-      
-      // attempt to do the transaction until it completes successfully.
-      while ((accountTransaction(src, dest, amount)) == -1)
-        usleep(10000); // sleep for 10 ms to avoid starvation.
-      transfer = 0;
-    }
-
-    usleep(10000); // sleep for 10 ms to avoid starvation.
+    for (int i = 0; i < numTransfers; i++)
+      accountTransaction(batch[i].src, batch[i].dest, batch[i].amount);
+    doneTransfers(&transferQueue, numTransfers);
   }
 
   return NULL;
@@ -354,28 +425,101 @@ void* worker(void* channel)
 
 /*
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
- * SUMMARY: isReaderComplete
- * This function checks if the reader thread has marked
- * itself as completed.
+ * SUMMARY: runWaves
+ * This function splits the scheduler's window into waves and
+ * queues them one at a time, waiting for the workers to finish
+ * each wave before the next one (which may share its accounts)
+ * is queued.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void runWaves()
+{
+  int numWaves = scheduleWaves(&scheduler);
+
+  for (int w = 0; w < numWaves; w++)
+  {
+    int first = scheduler.waveStart[w];
+    pushTransfers(&transferQueue, &scheduler.ordered[first], scheduler.waveStart[w + 1] - first);
+    waitTransfers(&transferQueue);
+  }
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: sendToShards
+ * This function routes a transfer to the owners of its accounts.
+ * If one shard owns both accounts the whole transfer goes to it,
+ * otherwise the source's owner gets a debit and the destination's
+ * owner a credit. Accounts are looked up here, so the owners
+ * never touch the account index.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void sendToShards(int src, int dest, int amount)
+{
+  account_t* srcNode = findAccount(src);
+  account_t* destNode = findAccount(dest);
+  if (srcNode == NULL || destNode == NULL)
+  {
+    printf("ERROR: Source (%d) OR destination (%d) could not be found.\n", src, dest);
+    return;
+  }
+
+  int srcShard = accountOwner(src, numWorkers);
+  int destShard = accountOwner(dest, numWorkers);
+  for (int shard = srcShard; ; shard = destShard)
+  {
+    transfer_t* t = &shardBatch[shard*TRANSFER_BATCH_SIZE + shardCount[shard]];
+    t->src = src;
+    t->dest = dest;
+    t->amount = amount;
+    t->srcNode = (shard == srcShard) ? srcNode : NULL;
+    t->destNode = (shard == destShard) ? destNode : NULL;
+
+    if (++shardCount[shard] == TRANSFER_BATCH_SIZE)
+      flushShard(shard);
+    if (shard == destShard)
+      break;
+  }
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: flushShard
+ * This function sends the reader's batch for a shard to the
+ * shard's mailbox.
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
  */
-int isReaderComplete()
+void flushShard(int shard)
 {
-  pthread_mutex_lock(&mutexComplete);
-  int complete = flagComplete;
-  pthread_mutex_unlock(&mutexComplete);
-  return complete;
+  pushTransfers(&mailboxes[shard], &shardBatch[shard*TRANSFER_BATCH_SIZE], shardCount[shard]);
+  shardCount[shard] = 0;
 }
 
 /*
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
- * SUMMARY: markReaderComplete
- * This function marks the reader thread as complete.
+ * SUMMARY: shardWorker
+ * This thread applies the debits and credits of its shard's
+ * mailbox. Only this thread writes the shard's balances, and
+ * each mailbox is filled in input order, so no account lock is
+ * needed and every account sees its transfers in order.
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
  */
-void markReaderComplete()
+void* shardWorker(int shard)
 {
-  pthread_mutex_lock(&mutexComplete);
-  flagComplete = 1;
-  pthread_mutex_unlock(&mutexComplete);
-}
\ No newline at end of file
+  transfer_t batch[TRANSFER_BATCH_SIZE];
+  int numTransfers;
+
+  while ((numTransfers = popTransfers(&mailboxes[shard], batch, TRANSFER_BATCH_SIZE)) > 0)
+  {
+    for (int i = 0; i < numTransfers; i++)
+    {
+      if (batch[i].srcNode != NULL)
+        batch[i].srcNode->balance -= batch[i].amount;
+      if (batch[i].destNode != NULL)
+        batch[i].destNode->balance += batch[i].amount;
+    }
+    doneTransfers(&mailboxes[shard], numTransfers);
+  }
+
+  return NULL;
+}
@@ -0,0 +1,180 @@
+/*
+ * SUMMARY: transferQueue.c
+ * This file contains the bounded queue that hands transfers from the reader
+ * thread to the worker threads. Any number of threads may push and pop.
+ *
+ * NOTE: Transfers are moved in batches, so the mutex is taken once per batch
+ *    instead of once per transfer. A thread that finds the queue full (push)
+ *    or empty (pop) sleeps on a condition instead of polling.
+ *
+ * NOTE: A queue made with spread > 1 lets a pop take at most 1/spread of the
+ *    queued transfers, so a short burst (a wave) is spread over that many workers
+ *    instead of going to the first one. With spread 1 a pop takes a full batch
+ *    whenever one is queued, which is cheaper when bursts don't matter.
+ *    Consumers report finished transfers with doneTransfers, which lets a
+ *    producer wait (waitTransfers) until everything it pushed has run.
+ */
+
+#include "transferQueue.h"
+
+/*
+* +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+*                        PUBLIC FUNCTIONS
+* +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+*/
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: initTransferQueue
+ * This function allocates an empty queue that holds up to
+ * 'capacity' transfers. Pops are limited to 1/spread of the
+ * queued transfers.
+ *
+ * NOTE: Returns -1 if the queue cannot be allocated.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int initTransferQueue(transfer_queue_t* q, int capacity, int spread)
+{
+  if (capacity <= 0 || spread <= 0)
+    return -1;
+
+  q->ring = (transfer_t*)malloc(capacity*sizeof(transfer_t));
+  if (q->ring == NULL)
+    return -1;
+
+  q->capacity = capacity;
+  q->head = 0;
+  q->count = 0;
+  q->pending = 0;
+  q->spread = spread;
+  q->closed = 0;
+  pthread_mutex_init(&q->mutex, NULL);
+  pthread_cond_init(&q->notEmpty, NULL);
+  pthread_cond_init(&q->notFull, NULL);
+  pthread_cond_init(&q->drained, NULL);
+  return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: destroyTransferQueue
+ * This function deallocates the queue. No thread may be using
+ * it anymore.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void destroyTransferQueue(transfer_queue_t* q)
+{
+  free(q->ring);
+  q->ring = NULL;
+  pthread_mutex_destroy(&q->mutex);
+  pthread_cond_destroy(&q->notEmpty);
+  pthread_cond_destroy(&q->notFull);
+  pthread_cond_destroy(&q->drained);
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: pushTransfers
+ * This function queues all 'n' transfers in order. While the
+ * queue is full it sleeps until a worker makes room.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void pushTransfers(transfer_queue_t* q, transfer_t* transfers, int n)
+{
+  pthread_mutex_lock(&q->mutex);
+  while (n > 0)
+  {
+    while (q->count == q->capacity)
+      pthread_cond_wait(&q->notFull, &q->mutex);
+
+    // copy as many as fit.. a batch bigger than the free space is
+    // queued in parts as the workers drain the queue.
+    int room = q->capacity - q->count;
+    int num = (n < room) ? n : room;
+    for (int i = 0; i < num; i++)
+      q->ring[(q->head + q->count + i) % q->capacity] = transfers[i];
+    q->count += num;
+    q->pending += num;
+    transfers += num;
+    n -= num;
+
+    pthread_cond_broadcast(&q->notEmpty);
+  }
+  pthread_mutex_unlock(&q->mutex);
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: popTransfers
+ * This function copies the oldest 1..max queued transfers into
+ * 'transfers', but no more than 1/spread of the queued ones. While the
+ * queue is empty it sleeps until more are pushed or the queue is
+ * closed. Call doneTransfers once they have run.
+ *
+ * NOTE: Returns the number of transfers copied, or 0 once the
+ *    queue is closed and empty.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int popTransfers(transfer_queue_t* q, transfer_t* transfers, int max)
+{
+  pthread_mutex_lock(&q->mutex);
+  while (q->count == 0 && !q->closed)
+    pthread_cond_wait(&q->notEmpty, &q->mutex);
+
+  int share = (q->count + q->spread - 1) / q->spread;
+  int num = (share < max) ? share : max;
+  for (int i = 0; i < num; i++)
+    transfers[i] = q->ring[(q->head + i) % q->capacity];
+  q->head = (q->head + num) % q->capacity;
+  q->count -= num;
+
+  if (num > 0)
+    pthread_cond_broadcast(&q->notFull);
+  pthread_mutex_unlock(&q->mutex);
+  return num;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: doneTransfers
+ * This function reports that 'n' popped transfers have run.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void doneTransfers(transfer_queue_t* q, int n)
+{
+  pthread_mutex_lock(&q->mutex);
+  q->pending -= n;
+  if (q->pending == 0)
+    pthread_cond_broadcast(&q->drained);
+  pthread_mutex_unlock(&q->mutex);
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: waitTransfers
+ * This function sleeps until every pushed transfer has been
+ * popped and reported done.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void waitTransfers(transfer_queue_t* q)
+{
+  pthread_mutex_lock(&q->mutex);
+  while (q->pending > 0)
+    pthread_cond_wait(&q->drained, &q->mutex);
+  pthread_mutex_unlock(&q->mutex);
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: closeTransferQueue
+ * This function marks that nothing more will be pushed and wakes
+ * up every sleeping worker. Queued transfers can still be popped.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void closeTransferQueue(transfer_queue_t* q)
+{
+  pthread_mutex_lock(&q->mutex);
+  q->closed = 1;
+  pthread_cond_broadcast(&q->notEmpty);
+  pthread_mutex_unlock(&q->mutex);
+}
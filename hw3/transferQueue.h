@@ -0,0 +1,86 @@
+#ifndef _SRC_TRANSFER_QUEUE_SRC_
+#define _SRC_TRANSFER_QUEUE_SRC_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "accountSearchTree.h"
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ *                       DEFINES
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+
+#define TRANSFER_QUEUE_SIZE     4096  // transfers the reader can queue ahead of the workers
+#define TRANSFER_BATCH_SIZE     64    // transfers moved per push/pop
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ *                  TYPEDEFS / STRUCTS
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+
+/*
+ * SUMMARY: transfer_t
+ * src - source account number for the transfer.
+ * dest - destination account number for the transfer.
+ * amount - amount of money being transferred from source -> destination.
+ * srcNode - shard mode.. account to debit, NULL for a credit only message.
+ * destNode - shard mode.. account to credit, NULL for a debit only message.
+ */
+typedef struct transfer
+{
+  int src;
+  int dest;
+  int amount;
+  account_t* srcNode;
+  account_t* destNode;
+} transfer_t;
+
+/*
+ * SUMMARY: transfer_queue_t
+ * ring - transfers waiting for a worker, 'capacity' slots.
+ * head - slot of the oldest queued transfer.
+ * count - number of queued transfers.
+ * pending - transfers pushed but not reported done yet (queued or running).
+ * spread - a pop takes at most 1/spread of the queued transfers (1 = no limit).
+ * closed - set once nothing more will be pushed.
+ * mutex - guards every field above.
+ * notEmpty - signaled when transfers are pushed or the queue is closed.
+ * notFull - signaled when transfers are popped.
+ * drained - signaled when 'pending' drops to 0.
+ */
+typedef struct transfer_queue
+{
+  transfer_t* ring;
+  int capacity;
+  int head;
+  int count;
+  int pending;
+  int spread;
+  int closed;
+  pthread_mutex_t mutex;
+  pthread_cond_t notEmpty;
+  pthread_cond_t notFull;
+  pthread_cond_t drained;
+} transfer_queue_t;
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ *                       PROTOTYPES
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+
+int initTransferQueue(transfer_queue_t* q, int capacity, int spread);
+void destroyTransferQueue(transfer_queue_t* q);
+void pushTransfers(transfer_queue_t* q, transfer_t* transfers, int n);
+int popTransfers(transfer_queue_t* q, transfer_t* transfers, int max);
+void doneTransfers(transfer_queue_t* q, int n);
+void waitTransfers(transfer_queue_t* q);
+void closeTransferQueue(transfer_queue_t* q);
+
+#endif
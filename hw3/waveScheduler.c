@@ -0,0 +1,179 @@
+/*
+ * SUMMARY: waveScheduler.c
+ * This file contains the conflict aware scheduler for transfers. A window of
+ * parsed transfers is split into waves: no two transfers of a wave share an
+ * account, so a wave can be run by all workers at once without contention.
+ *
+ * NOTE: Two transfers conflict if they share the source or destination account.
+ *    Each transfer goes into the wave after the last wave that used either of its
+ *    accounts (a greedy coloring of the conflict graph, built in input order), so
+ *    the transfers of any one account still run in input order and the balances
+ *    are those of running the window sequentially.
+ *
+ * NOTE: The account -> wave table is only valid for one window. Slots carry the
+ *    window number, so starting a new window does not have to clear the table.
+ */
+
+#include "waveScheduler.h"
+
+/*
+* +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+*                        PUBLIC FUNCTIONS
+* +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+*/
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: initWaveScheduler
+ * This function allocates a scheduler for windows of up to
+ * 'capacity' transfers.
+ *
+ * NOTE: Returns -1 if the scheduler cannot be allocated.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int initWaveScheduler(wave_scheduler_t* s, int capacity)
+{
+  if (capacity <= 0)
+    return -1;
+
+  // a window touches at most 2 accounts per transfer.. keep the
+  // table at most half full.
+  uint32_t slots = 1;
+  while (slots < 4*(uint32_t)capacity)
+    slots <<= 1;
+
+  s->count = 0;
+  s->capacity = capacity;
+  s->window = 1;
+  s->mask = slots - 1;
+  s->transfers = (transfer_t*)malloc(capacity*sizeof(transfer_t));
+  s->ordered = (transfer_t*)malloc(capacity*sizeof(transfer_t));
+  s->waveStart = (int*)malloc((capacity + 1)*sizeof(int));
+  s->waveOf = (int*)malloc(capacity*sizeof(int));
+  s->slots = (wave_slot_t*)calloc(slots, sizeof(wave_slot_t));
+  if (s->transfers == NULL || s->ordered == NULL || s->waveStart == NULL || s->waveOf == NULL || s->slots == NULL)
+    return -1;
+  return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: destroyWaveScheduler
+ * This function deallocates the scheduler.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+void destroyWaveScheduler(wave_scheduler_t* s)
+{
+  free(s->transfers);
+  free(s->ordered);
+  free(s->waveStart);
+  free(s->waveOf);
+  free(s->slots);
+  s->transfers = NULL;
+  s->ordered = NULL;
+  s->waveStart = NULL;
+  s->waveOf = NULL;
+  s->slots = NULL;
+  s->count = 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: addTransfer
+ * This function appends a transfer to the window.
+ *
+ * NOTE: Returns -1 if the window is already full.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int addTransfer(wave_scheduler_t* s, int src, int dest, int amount)
+{
+  if (s->count == s->capacity)
+    return -1;
+
+  s->transfers[s->count].src = src;
+  s->transfers[s->count].dest = dest;
+  s->transfers[s->count].amount = amount;
+  s->count++;
+  return 0;
+}
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: scheduleWaves
+ * This function splits the window into waves. Wave w is
+ * ordered[waveStart[w]] .. ordered[waveStart[w + 1] - 1], in input
+ * order. The window is emptied for the next transfers.
+ *
+ * NOTE: Returns the number of waves.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+int scheduleWaves(wave_scheduler_t* s)
+{
+  int numWaves = 0;
+
+  // 1) wave of each transfer.. one after the last wave of either account.
+  for (int i = 0; i < s->count; i++)
+  {
+    wave_slot_t* src = _findWaveSlot(s, s->transfers[i].src);
+    wave_slot_t* dest = _findWaveSlot(s, s->transfers[i].dest);
+    int wave = ((src->wave > dest->wave) ? src->wave : dest->wave) + 1;
+
+    src->wave = wave;
+    dest->wave = wave;
+    s->waveOf[i] = wave;
+    if (wave + 1 > numWaves)
+      numWaves = wave + 1;
+  }
+
+  // 2) counting sort by wave.. stable, so each wave stays in input order.
+  for (int w = 0; w <= numWaves; w++)
+    s->waveStart[w] = 0;
+  for (int i = 0; i < s->count; i++)
+    s->waveStart[s->waveOf[i] + 1]++;
+  for (int w = 0; w < numWaves; w++)
+    s->waveStart[w + 1] += s->waveStart[w];
+  for (int i = 0; i < s->count; i++)
+    s->ordered[s->waveStart[s->waveOf[i]]++] = s->transfers[i];
+
+  // the placement loop advanced every start to the next wave's start
+  for (int w = numWaves; w > 0; w--)
+    s->waveStart[w] = s->waveStart[w - 1];
+  s->waveStart[0] = 0;
+
+  s->count = 0;
+  s->window++;
+  return numWaves;
+}
+
+/*
+* +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+*                        PRIVATE FUNCTIONS
+* +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+*/
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: _findWaveSlot
+ * This function returns the table slot of an account for the
+ * current window. An account not seen yet in this window gets
+ * a fresh slot with wave -1.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+wave_slot_t* _findWaveSlot(wave_scheduler_t* s, int account)
+{
+  // multiplicative hash.. the high bits are folded down before masking.
+  uint32_t h = (uint32_t)account*0x9e3779b1u;
+  uint32_t i = (h ^ (h >> 16)) & s->mask;
+
+  while (s->slots[i].window == s->window)
+  {
+    if (s->slots[i].account_number == account)
+      return &s->slots[i];
+    i = (i + 1) & s->mask;
+  }
+
+  s->slots[i].account_number = account;
+  s->slots[i].wave = -1;
+  s->slots[i].window = s->window;
+  return &s->slots[i];
+}
@@ -0,0 +1,69 @@
+#ifndef _SRC_WAVE_SCHEDULER_SRC_
+#define _SRC_WAVE_SCHEDULER_SRC_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include "transferQueue.h"
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ *                  TYPEDEFS / STRUCTS
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+
+/*
+ * SUMMARY: wave_slot_t
+ * account_number - key of the slot.
+ * wave - last wave of the current window that uses the account.
+ * window - window the slot was written in, stale slots count as unused.
+ */
+typedef struct wave_slot
+{
+  int account_number;
+  int wave;
+  int window;
+} wave_slot_t;
+
+/*
+ * SUMMARY: wave_scheduler_t
+ * transfers - the window of parsed transfers, in input order.
+ * count - number of transfers in the window.
+ * capacity - max transfers in a window.
+ * ordered - the window sorted by wave (filled by scheduleWaves).
+ * waveStart - first transfer of each wave in 'ordered', plus one past the last.
+ * waveOf - wave of each transfer in the window.
+ * slots - account number -> wave table, (mask + 1) slots.
+ * window - number of the current window (1, 2, ..).
+ */
+typedef struct wave_scheduler
+{
+  transfer_t* transfers;
+  int count;
+  int capacity;
+  transfer_t* ordered;
+  int* waveStart;
+  int* waveOf;
+  wave_slot_t* slots;
+  uint32_t mask;
+  int window;
+} wave_scheduler_t;
+
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ *                       PROTOTYPES
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ */
+
+// PUBLIC
+int initWaveScheduler(wave_scheduler_t* s, int capacity);
+void destroyWaveScheduler(wave_scheduler_t* s);
+int addTransfer(wave_scheduler_t* s, int src, int dest, int amount);
+int scheduleWaves(wave_scheduler_t* s);
+
+// PRIVATE
+wave_slot_t* _findWaveSlot(wave_scheduler_t* s, int account);
+
+#endif
@@ -72,11 +72,12 @@ int main(int argc, char **argv)
   int bufIndex = 0;
 
   // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
-  // turn off stdout/stdin buffers
+  // turn off stdout/stdin buffers + fill the rule table
   // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
 
   setbuf(stdout, NULL);
   setbuf(stdin, NULL);
+  rulesDefault();
 
   // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
   // handle command line arguments
@@ -113,7 +114,11 @@ int main(int argc, char **argv)
 
   // initialize the mmap'd condition variable before starting all processes
   cond->flag = 0;
-  pthread_mutex_init(&cond->mutex, NULL);
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+  pthread_mutex_init(&cond->mutex, &attr);
+  pthread_mutexattr_destroy(&attr);
 
   // +-----+-----+-----+-----+-----+-----+-----+-----+-----+
   // start all worker threads
@@ -177,7 +182,10 @@ void mapper(void)
     //printf("Tuple read from input.txt: %.4s - %c - %.15s\n", &tupleIn->userid[0], tupleIn->action, &tupleIn->topic[0]);
     // Map the input tuple to work with the reducer processes
     if ((tupleOut = map(tupleIn)) == NULL)
+    {
       printf("Error mapping tuple to reducer format.\n");
+      continue;
+    }
 
     // continue to write to the fifo until it is successful
     while(fifo->writeUser(tupleOut->userid, tupleOut) == -1)
@@ -116,25 +116,32 @@ reducer_tuple_fifo_t* Fifo(int num_channels, int buf_depth)
   // to channels.
   for (int i = 0; i < num_channels; i++)
   {
-    strncpy(fifo->_chmap[i].userid, "\0\0\0\0", LEN_USER_ID);
+    fifo->_chmap[i].userid = USER_KEY_NONE;
     fifo->_chmap[i].channel = -1;
   }
 
-  // make sure all mutexes are unlocked
+  // make sure all mutexes are unlocked. The mutexes live in shared
+  // memory and are used by the forked reducers, so they must be process
+  // shared.. a private mutex never wakes a waiter in another process.
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+
   for (int i = 0; i < num_channels; i++)
   {
-    if (pthread_mutex_init(&fifo->_mutex[i], NULL) != 0)
+    if (pthread_mutex_init(&fifo->_mutex[i], &attr) != 0)
     {
       printf("ERROR (fifo.c): initializing mutex\n");
       exit(0);
     }
   }
 
-  if (pthread_mutex_init(&fifo->_mutex_chmap, NULL) != 0)
+  if (pthread_mutex_init(&fifo->_mutex_chmap, &attr) != 0)
   {
     printf("ERROR (fifo.c): initializing chmap mutex\n");
     exit(0);
   }
+  pthread_mutexattr_destroy(&attr);
 
   return fifo;
 }
@@ -177,7 +184,7 @@ reducer_tuple_in_t* fifo_read(reducer_tuple_fifo_t* fifo, int ch)
     fifo->_size[ch]--;
 
     // handle wrap around when buffer is full
-    if (fifo->_rdindex[ch]++ == fifo->_depth[ch])
+    if (++fifo->_rdindex[ch] == fifo->_depth[ch])
       fifo->_rdindex[ch] = 0;
   }
 
@@ -215,7 +222,7 @@ int fifo_write(reducer_tuple_fifo_t* fifo, int ch, reducer_tuple_in_t* val)
     fifo->_size[ch]++;
 
     // handle wrap around when buffer is full
-    if (fifo->_wrindex[ch]++ == fifo->_depth[ch])
+    if (++fifo->_wrindex[ch] == fifo->_depth[ch])
       fifo->_wrindex[ch] = 0;
   }
 
@@ -258,6 +265,7 @@ int copy_reducer_tuple(reducer_tuple_in_t* copy, reducer_tuple_in_t* orig)
 */
 int fifo_get_user_channel(char* userid)
 {
+  user_key_t key = userKey(userid);
   int ch = 0;
 
   pthread_mutex_lock(&fifo->_mutex_chmap);
@@ -267,7 +275,7 @@ int fifo_get_user_channel(char* userid)
   {
     // This portion of the array has not been defined yet. The user 
     // does not exist yet, so add it to the end.
-    if (strncmp(fifo->_chmap[i].userid, "\0\0\0\0", LEN_USER_ID) == 0)
+    if (fifo->_chmap[i].userid == USER_KEY_NONE)
     {
       // check if there is still enough room to add another channel.
       if (fifo->num_channels_used == fifo->num_channels)
@@ -277,7 +285,7 @@ int fifo_get_user_channel(char* userid)
         return -1;
       }
 
-      strncpy(fifo->_chmap[i].userid, userid, LEN_USER_ID);
+      fifo->_chmap[i].userid = key;
       fifo->_chmap[i].channel = i;
       fifo->num_channels_used++;
       ch = i;
@@ -285,7 +293,7 @@ int fifo_get_user_channel(char* userid)
     }
 
     // If a user id match is found, return the channel number.
-    else if (strncmp(fifo->_chmap[i].userid, userid, LEN_USER_ID) == 0)
+    else if (fifo->_chmap[i].userid == key)
     {
       ch = i;
       break;
@@ -41,7 +41,7 @@
 // This structure will map the user id's to the appropriate channel numbers.
 typedef struct channel_map
 {
-  char userid[LEN_USER_ID];
+  user_key_t userid;  // packed user id, USER_KEY_NONE while unused
   int channel;
 } channel_map_t;
 
@@ -6,10 +6,11 @@
  * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
 */
 
-// The RULE_ACTIONS and RULE_WEIGHTS below define how each action is mapped
-// to the appropriate weight.
-static const char RULE_ACTION[MAPPING_COUNT] = {'P', 'L', 'D', 'C', 'S'};
-static const int32_t RULE_WEIGHT[MAPPING_COUNT] = {50, 20, -10, 30, 40};
+// RULE_TABLE maps every action byte to its weight (RULE_NONE when the
+// action has no rule), so mapping a tuple is a single indexed load.
+// Filled by rulesDefault before any tuple is mapped.
+#define _RULE_ENTRY(action, weight) RULE_TABLE[(uint8_t)(action)] = weight;
+static int32_t RULE_TABLE[RULE_TABLE_SIZE];
 
 /*
  * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
@@ -17,6 +18,20 @@ static const int32_t RULE_WEIGHT[MAPPING_COUNT] = {50, 20, -10, 30, 40};
  * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
 */
 
+/*
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+ * SUMMARY: rulesDefault
+ * This function fills RULE_TABLE with the default rule set.
+ * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
+*/
+void rulesDefault(void)
+{
+  for (int i = 0; i < RULE_TABLE_SIZE; i++)
+    RULE_TABLE[i] = RULE_NONE;
+
+  DEFAULT_RULES(_RULE_ENTRY)
+}
+
 /*
  * +-----+-----+-----+-----+-----+-----+-----+-----+-----+-----+
  * SUMMARY: console_tuple_read
@@ -167,42 +182,18 @@ mapper_tuple_in_t* mapper_read_tuple(void)
  */
 reducer_tuple_in_t* map(mapper_tuple_in_t* in)
 {
-  reducer_tuple_in_t* out = (reducer_tuple_in_t*)malloc(sizeof(reducer_tuple_in_t));
-  uint8_t index;
-  int error;
+  int32_t weight = RULE_TABLE[(uint8_t)in->action];
+  reducer_tuple_in_t* out = NULL;
 
-  for (index = 0; index < MAPPING_COUNT; index++)
+  // known action.. deep copy the other items to the output
+  if (weight != RULE_NONE)
   {
-    // action used was found.. mark as successful and 
-    // create the mapping. 
-    if (in->action == RULE_ACTION[index])
-    {
-      error = 0;
-      out->weight = RULE_WEIGHT[index];
-      break;
-    }
-
-    // if the action was not found, mark as  an error (hopefully temporarily)
-    // and continue the search.
-    else
-    {
-      error = -1;
-    }
+    out = (reducer_tuple_in_t*)malloc(sizeof(reducer_tuple_in_t));
+    out->weight = weight;
+    memcpy(out->topic, in->topic, LEN_TOPIC*sizeof(char));
+    memcpy(out->userid, in->userid, LEN_USER_ID*sizeof(char));
   }
 
-  // if the action search was successful, perform a deep copy from the
-  // inputs to the outputs on all other items.
-  if (error == 0)
-  {
-    // copy TOPIC and USERID
-    strncpy(out->topic, in->topic, LEN_TOPIC*sizeof(char));
-    strncpy(out->userid, in->userid, LEN_USER_ID*sizeof(char));
-    free(in);
-    return out;
-  }
-  else
-  {
-    free(out);
-    return NULL;
-  }
+  free(in);
+  return out;
 }
\ No newline at end of file
@@ -14,7 +14,11 @@
  * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
 */
 
-#define MAPPING_COUNT           5
+// Default rule set as (action, weight) pairs. rulesDefault expands it
+// into the RULE_TABLE lookup in mapper.c.
+#define DEFAULT_RULES(X)        X('P', 50) X('L', 20) X('D', -10) X('C', 30) X('S', 40)
+#define RULE_TABLE_SIZE         256         // one entry per action byte
+#define RULE_NONE               INT32_MIN   // RULE_TABLE entry for an unmapped action
 #define ENTER                   10
 #define LB                      '('
 #define RB                      ')'
@@ -51,6 +55,7 @@ typedef enum tupleItem
  * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
 */
 
+void rulesDefault(void);
 mapper_tuple_in_t* mapper_read_tuple(void);
 reducer_tuple_in_t* map(mapper_tuple_in_t* in);
 
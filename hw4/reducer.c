@@ -91,7 +91,7 @@ void reduce(reducer_tuple_in_t* tuple)
   for (int i = 0; i < numTuples; i++)
   {
     t = &node->tuple;
-    if (strncmp(&t->topic[0], &tuple->topic[0], LEN_TOPIC) == 0)
+    if (topicEqual(&t->topic[0], &tuple->topic[0]))
     {
       found = 1;
       break;
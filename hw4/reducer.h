@@ -16,6 +16,34 @@
 
 #define LEN_USER_ID   4
 #define LEN_TOPIC     15
+#define USER_KEY_NONE 0   // packed key of an unused user id ("\0\0\0\0")
+
+/*
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+ *                           PACKED KEYS
+ * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+
+*/
+
+// A user id packed into one word, so two ids compare in one instruction.
+typedef uint32_t user_key_t;
+
+static inline user_key_t userKey(const char* userid)
+{
+  user_key_t key;
+  memcpy(&key, userid, LEN_USER_ID);
+  return key;
+}
+
+// compares two LEN_TOPIC fields with two overlapping 8 byte loads
+static inline int topicEqual(const char* a, const char* b)
+{
+  uint64_t a0, a1, b0, b1;
+  memcpy(&a0, a, sizeof(a0));
+  memcpy(&a1, a + LEN_TOPIC - sizeof(a1), sizeof(a1));
+  memcpy(&b0, b, sizeof(b0));
+  memcpy(&b1, b + LEN_TOPIC - sizeof(b1), sizeof(b1));
+  return ((a0 ^ b0) | (a1 ^ b1)) == 0;
+}
 
 /*
  * +=====+=====+=====+=====+=====+=====+=====+=====+=====+=====+